@@ -0,0 +1,178 @@
+/**
+ * @file AsyncFile.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "AsyncFile.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name
+ * @param block_size  bytes per block if the file gets created (an existing file keeps its own)
+ * @throws std::invalid_argument if block_size isn't 4, 8, 16 or 32kB
+ */
+AsyncFile::AsyncFile(string name, uint block_size) : HeapFile(name, block_size), path(""), fd(-1),
+                                                     async_io(AsyncIO::get()) {
+    this->first_block = 1;
+    this->dbfilename = this->name + ".blk";
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    this->path = home == nullptr ? this->dbfilename : string(home) + "/" + this->dbfilename;
+}
+
+/**
+ * Destructor - write back our dirty blocks while we can still get at the file.
+ */
+AsyncFile::~AsyncFile() {
+    if (!this->closed) {
+        write_header();
+        this->pool.flush(this);
+        this->pool.discard(this);
+        ::close(this->fd);
+        this->closed = true;
+    }
+}
+
+/**
+ * Delete the physical file.
+ */
+void AsyncFile::drop(void) {
+    this->pool.discard(this);  // no point writing back blocks (or the header) we are about to remove
+    if (!this->closed) {
+        ::close(this->fd);
+        this->fd = -1;
+        this->closed = true;
+    }
+    this->files.closed(this);
+    unlink(this->path.c_str());
+    this->fsm.drop();
+    this->overflow.drop();
+}
+
+/**
+ * Write back our dirty blocks and close the physical file.
+ */
+void AsyncFile::close(void) {
+    if (!this->closed) {
+        write_header();
+        this->pool.flush(this);
+        this->pool.discard(this);
+        ::close(this->fd);
+        this->fd = -1;
+        this->closed = true;
+    }
+    this->fsm.close();
+    this->overflow.close();
+    this->files.closed(this);
+}
+
+/**
+ * Open the file, creating it first if asked to.
+ * @param flags  DB_CREATE to make a new file (anything else opens an existing one)
+ * @throws DbException if the file doesn't exist (or does when creating)
+ */
+void AsyncFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    if (flags) {
+        this->fd = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (this->fd < 0)
+            throw DbException(("cannot create " + this->path).c_str(), errno);
+        if (ftruncate(this->fd, this->block_size) != 0) {  // block 0, all zeros but for the header
+            ::close(this->fd);
+            throw DbRelationError("cannot write " + this->dbfilename);
+        }
+        this->last = 0;
+        this->row_count = 0;
+        this->free_bytes = 0;
+        this->schema_version = 0;
+        write_header();
+    } else {
+        this->fd = ::open(this->path.c_str(), O_RDWR);
+        if (this->fd < 0)
+            throw DbException(("cannot open " + this->path).c_str(), errno);
+        try {
+            read_header();
+        } catch (DbRelationError &e) {
+            ::close(this->fd);
+            throw;
+        }
+    }
+    this->fsm.set_heap_block_size(this->block_size);
+    this->overflow.set_block_size(this->block_size);
+    this->closed = false;
+    if (!flags) {
+        this->fsm.open();
+        this->overflow.open();
+    }
+}
+
+/**
+ * Read our fields from the header at the start of the file.
+ * @throws DbRelationError if there isn't one
+ */
+void AsyncFile::read_header() {
+    Header header;
+    if (pread(this->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != MAGIC
+        || !DbBlock::valid_block_size(header.block_size) || header.overflow_last == 0)
+        throw DbRelationError(this->dbfilename + " is not a heap file");
+    this->block_size = header.block_size;
+    set_header(header);
+}
+
+/**
+ * Write our fields to the header at the start of the file.
+ */
+void AsyncFile::write_header() {
+    Header header = get_header();
+    header.magic = MAGIC;
+    if (pwrite(this->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+        throw DbRelationError("cannot write " + this->dbfilename);
+}
+
+/**
+ * Read a block from the file into the given memory (a buffer frame).
+ * @param block_id  which block to read
+ * @param data      where to put it (must have room for block_size bytes)
+ */
+void AsyncFile::read_block(BlockID block_id, void *data) {
+    AsyncIO::Read read = {(off_t) block_id * this->block_size, (char *) data, this->block_size};
+    this->async_io.read(this->fd, vector<AsyncIO::Read>(1, read));
+}
+
+/**
+ * Write a block from the given memory (a buffer frame) to the file.
+ * @param block_id  which block to write
+ * @param data      the block's bytes
+ */
+void AsyncFile::write_block(BlockID block_id, const void *data) {
+    off_t offset = (off_t) block_id * this->block_size;
+    uint done = 0;
+    while (done < this->block_size) {
+        ssize_t n = pwrite(this->fd, (const char *) data + done, this->block_size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            throw DbRelationError("cannot write " + this->dbfilename + ": " + strerror(errno));
+        done += (uint) n;
+    }
+}
+
+/**
+ * Read several blocks at once, overlapped when we have io_uring.
+ * @param block_ids  which blocks
+ * @param data       where to put each of them
+ */
+void AsyncFile::read_blocks(const BlockIDs &block_ids, const vector<char *> &data) {
+    vector<AsyncIO::Read> reads;
+    for (uint i = 0; i < block_ids.size(); i++) {
+        AsyncIO::Read read = {(off_t) block_ids[i] * this->block_size, data[i], this->block_size};
+        reads.push_back(read);
+    }
+    this->async_io.read(this->fd, reads);
+}
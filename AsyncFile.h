@@ -0,0 +1,60 @@
+/**
+ * @file AsyncFile.h - Implementation of storage_engine with a plain heap file read in batches.
+ * AsyncFile: HeapFile
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include "HeapFile.h"
+#include "AsyncIO.h"
+
+/**
+ * @class AsyncFile - heap file kept in a plain file, with overlapped reads for scans
+ *
+ * Blocks live in <name>.blk in the database environment's home directory, block n at offset
+ * n * block_size (block 0 is the header, HeapFile::Header with our own magic number), and go
+ * through the BufferPool just as HeapFile's do. The difference is read-ahead: a scan asks for
+ * a run of blocks ahead of where it is and they are all read at once through AsyncIO, so
+ * many reads are waiting on the disk together instead of one after another.
+ */
+class AsyncFile : public HeapFile {
+public:
+    /**
+     * Identifies one of our files (first 4 bytes of the header)
+     */
+    static const uint32_t MAGIC = 0x41424C4B;
+
+    AsyncFile(std::string name, uint block_size = DbBlock::BLOCK_SZ);
+
+    virtual ~AsyncFile();
+
+    AsyncFile(const AsyncFile &other) = delete;
+
+    AsyncFile(AsyncFile &&temp) = delete;
+
+    AsyncFile &operator=(const AsyncFile &other) = delete;
+
+    AsyncFile &operator=(AsyncFile &&temp) = delete;
+
+    virtual void drop(void);
+
+    virtual void close(void);
+
+protected:
+    std::string path;
+    int fd;
+    AsyncIO &async_io;
+
+    virtual void db_open(uint flags = 0);
+
+    virtual void read_header();
+
+    virtual void write_header();
+
+    virtual void read_block(BlockID block_id, void *data);
+
+    virtual void write_block(BlockID block_id, const void *data);
+
+    virtual void read_blocks(const BlockIDs &block_ids, const std::vector<char *> &data);
+};
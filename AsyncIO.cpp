@@ -0,0 +1,223 @@
+/**
+ * @file AsyncIO.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "AsyncIO.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+using namespace std;
+
+/**
+ * Get the process-wide instance (set up on first use).
+ * @return the AsyncIO
+ */
+AsyncIO &AsyncIO::get() {
+    static AsyncIO async_io;
+    return async_io;
+}
+
+/**
+ * Constructor - set up the ring, or settle for pread if we can't.
+ */
+AsyncIO::AsyncIO() : ring_fd(-1), sq_ring(nullptr), sq_ring_size(0), cq_ring(nullptr), cq_ring_size(0),
+                     sqes(nullptr), sqes_size(0), sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr),
+                     sq_array(nullptr), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), cqes(nullptr) {
+    if (!setup())
+        teardown();
+}
+
+/**
+ * Destructor
+ */
+AsyncIO::~AsyncIO() {
+    teardown();
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * Create the ring and map its queues into memory.
+ * @return true if we have a working ring
+ */
+bool AsyncIO::setup() {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    this->ring_fd = (int) syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params);
+    if (this->ring_fd < 0)
+        return false;
+
+    this->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    this->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        this->sq_ring_size = this->cq_ring_size = max(this->sq_ring_size, this->cq_ring_size);
+    this->sq_ring = mmap(nullptr, this->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         this->ring_fd, IORING_OFF_SQ_RING);
+    if (this->sq_ring == MAP_FAILED) {
+        this->sq_ring = nullptr;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        this->cq_ring = this->sq_ring;
+    } else {
+        this->cq_ring = mmap(nullptr, this->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             this->ring_fd, IORING_OFF_CQ_RING);
+        if (this->cq_ring == MAP_FAILED) {
+            this->cq_ring = nullptr;
+            return false;
+        }
+    }
+    this->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    this->sqes = mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd,
+                      IORING_OFF_SQES);
+    if (this->sqes == MAP_FAILED) {
+        this->sqes = nullptr;
+        return false;
+    }
+
+    char *sq = (char *) this->sq_ring;
+    this->sq_head = (unsigned *) (sq + params.sq_off.head);
+    this->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    this->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    this->sq_array = (unsigned *) (sq + params.sq_off.array);
+    char *cq = (char *) this->cq_ring;
+    this->cq_head = (unsigned *) (cq + params.cq_off.head);
+    this->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    this->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    this->cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+/**
+ * Unmap the queues and close the ring, leaving us on pread.
+ */
+void AsyncIO::teardown() {
+    if (this->sqes != nullptr)
+        munmap(this->sqes, this->sqes_size);
+    if (this->cq_ring != nullptr && this->cq_ring != this->sq_ring)
+        munmap(this->cq_ring, this->cq_ring_size);
+    if (this->sq_ring != nullptr)
+        munmap(this->sq_ring, this->sq_ring_size);
+    if (this->ring_fd >= 0)
+        ::close(this->ring_fd);
+    this->ring_fd = -1;
+    this->sq_ring = this->cq_ring = this->sqes = nullptr;
+}
+
+/**
+ * Do all the given reads, keeping up to QUEUE_DEPTH of them in flight.
+ * @param fd     file to read from
+ * @param reads  what to read and where to put it
+ */
+void AsyncIO::read(int fd, const vector<Read> &reads) {
+    if (!is_async()) {
+        for (auto const &r: reads)
+            read_sync(fd, r, 0);
+        return;
+    }
+    lock_guard<mutex> lock(this->ring_latch);
+    vector<iovec> iovecs(reads.size());
+    io_uring_sqe *sqe_array = (io_uring_sqe *) this->sqes;
+    io_uring_cqe *cqe_array = (io_uring_cqe *) this->cqes;
+    size_t submitted = 0, completed = 0;
+    while (completed < reads.size()) {
+        // fill the submission queue up to the depth we allow
+        unsigned tail = *this->sq_tail;
+        while (submitted < reads.size() && submitted - completed < QUEUE_DEPTH) {
+            const Read &r = reads[submitted];
+            iovecs[submitted].iov_base = r.data;
+            iovecs[submitted].iov_len = r.size;
+            unsigned index = tail & *this->sq_mask;
+            io_uring_sqe *sqe = &sqe_array[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd = fd;
+            sqe->off = (uint64_t) r.offset;
+            sqe->addr = (uint64_t) (uintptr_t) &iovecs[submitted];
+            sqe->len = 1;
+            sqe->user_data = submitted;
+            this->sq_array[index] = index;
+            tail++;
+            submitted++;
+        }
+        __atomic_store_n(this->sq_tail, tail, __ATOMIC_RELEASE);
+
+        // hand the kernel any it hasn't taken yet and wait for at least one to finish
+        unsigned to_submit = tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE);
+        int ret = (int) syscall(__NR_io_uring_enter, this->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN)
+            throw DbRelationError(string("io_uring_enter failed: ") + strerror(errno));
+
+        unsigned head = *this->cq_head;
+        while (head != __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe *cqe = &cqe_array[head & *this->cq_mask];
+            const Read &r = reads[cqe->user_data];
+            if (cqe->res < 0 || (uint) cqe->res < r.size)
+                read_sync(fd, r, cqe->res < 0 ? 0 : cqe->res);  // finish a failed or short read the slow way
+            head++;
+            completed++;
+        }
+        __atomic_store_n(this->cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+#else
+
+/**
+ * No io_uring here.
+ * @return false
+ */
+bool AsyncIO::setup() {
+    return false;
+}
+
+/**
+ * Nothing to undo.
+ */
+void AsyncIO::teardown() {
+}
+
+/**
+ * Do all the given reads, one after the other.
+ * @param fd     file to read from
+ * @param reads  what to read and where to put it
+ */
+void AsyncIO::read(int fd, const vector<Read> &reads) {
+    for (auto const &r: reads)
+        read_sync(fd, r, 0);
+}
+
+#endif
+
+/**
+ * Do (the rest of) one read with pread, zeroing whatever lies past the end of the file.
+ * @param fd    file to read from
+ * @param read  what to read and where to put it
+ * @param done  bytes of it already read
+ * @throws      DbRelationError if the read fails
+ */
+void AsyncIO::read_sync(int fd, const Read &read, ssize_t done) {
+    while ((uint) done < read.size) {
+        ssize_t n = pread(fd, read.data + done, read.size - done, read.offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw DbRelationError(string("read failed: ") + strerror(errno));
+        if (n == 0) {
+            memset(read.data + done, 0, read.size - done);
+            break;
+        }
+        done += n;
+    }
+}
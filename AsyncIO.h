@@ -0,0 +1,89 @@
+/**
+ * @file AsyncIO.h - Batched block reads, using io_uring where the kernel has it.
+ * AsyncIO
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <sys/types.h>
+#include <mutex>
+#include <vector>
+#include "storage_engine.h"
+
+/**
+ * @class AsyncIO - reads many blocks of a file at once
+ *
+ * On Linux, reads are queued on an io_uring so up to QUEUE_DEPTH of them are in flight
+ * together; as each one completes another is queued in its place. Without io_uring (an old
+ * kernel or headers, or a sandbox that forbids it) each read is done in turn with pread,
+ * which gives the same results, only without the overlap.
+ * There is one ring for the process, so threads take turns with it.
+ */
+class AsyncIO {
+public:
+    /**
+     * Most reads we keep in flight at a time
+     */
+    static const uint QUEUE_DEPTH = 64;
+
+    /**
+     * One block to read.
+     */
+    struct Read {
+        off_t offset;  // where in the file
+        char *data;    // where to put it
+        uint size;     // bytes to read (anything past the end of the file is zeroed)
+    };
+
+    /**
+     * The process-wide instance.
+     * @returns  the AsyncIO
+     */
+    static AsyncIO &get();
+
+    AsyncIO();
+
+    virtual ~AsyncIO();
+
+    AsyncIO(const AsyncIO &other) = delete;
+
+    AsyncIO(AsyncIO &&temp) = delete;
+
+    AsyncIO &operator=(const AsyncIO &other) = delete;
+
+    AsyncIO &operator=(AsyncIO &&temp) = delete;
+
+    /**
+     * Do all the given reads, returning once they have all completed.
+     * @param fd     file to read from
+     * @param reads  what to read and where to put it
+     * @throws       DbRelationError if a read fails
+     */
+    virtual void read(int fd, const std::vector<Read> &reads);
+
+    /**
+     * Check whether reads are really overlapped.
+     * @returns  true if we are using io_uring, false if falling back to pread
+     */
+    virtual bool is_async() const { return ring_fd >= 0; }
+
+protected:
+    int ring_fd;             // -1 if we don't have a ring
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    void *sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *cqes;
+    std::mutex ring_latch;   // held by the thread using the ring
+
+    virtual bool setup();
+
+    virtual void teardown();
+
+    static void read_sync(int fd, const Read &read, ssize_t done);
+};
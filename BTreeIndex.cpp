@@ -0,0 +1,680 @@
+/**
+ * @file BTreeIndex.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "BTreeIndex.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param relation     the table being indexed
+ * @param name         name of the index
+ * @param key_columns  columns of the search key, in order
+ * @param unique       whether no two rows may have the same key
+ */
+BTreeIndex::BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), file(nullptr), closed(true), stat_id(0), root_id(0),
+          height(0), key_profile(get_key_profile()), sort_memory(KeySorter::DEFAULT_MEMORY) {
+    this->file = new HeapFile(relation.get_table_name() + "-" + name);
+}
+
+BTreeIndex::~BTreeIndex() {
+    close();
+    delete this->file;
+}
+
+/**
+ * Create the index file and build the tree from the rows already in the table: one scan
+ * collects their keys, which are sorted and then built into the tree bottom-up.
+ * @throws DbRelationError if a row's key is too big to index (then the index file is removed)
+ */
+void BTreeIndex::create() {
+    this->file->create();
+    this->closed = false;
+    this->stat_id = this->file->next_block_id(0);  // the page create() makes
+    DbCursor *rows = nullptr;
+    try {
+        KeySorter sorter(this->key_profile, this->sort_memory);
+        rows = this->relation.cursor(nullptr, &this->key_columns);
+        Handle handle;
+        ValueViews values;
+        while (rows->next(handle, values)) {
+            BTreeKey key;
+            for (auto const &value: values)
+                key.first.push_back(value.to_value());
+            key.second = handle;
+            if (BTreeNode::key_size(this->key_profile, key) > BTreeNode::max_key_size(*this->file))
+                throw DbRelationError("key too big to index");  // before it goes in a run
+            sorter.add(key);
+        }
+        delete rows;
+        rows = nullptr;
+        sorter.finish();
+        build(sorter);
+    } catch (...) {
+        delete rows;
+        drop();
+        throw;
+    }
+}
+
+/**
+ * Remove the index file.
+ */
+void BTreeIndex::drop() {
+    this->file->drop();
+    this->closed = true;
+}
+
+/**
+ * Open the index file and read where the root is.
+ */
+void BTreeIndex::open() {
+    if (!this->closed)
+        return;
+    this->file->open();
+    this->stat_id = this->file->next_block_id(0);
+    read_stat();
+    this->closed = false;
+}
+
+/**
+ * Close the index file.
+ */
+void BTreeIndex::close() {
+    if (this->closed)
+        return;
+    this->file->close();
+    this->closed = true;
+}
+
+/**
+ * Write back the index's changed blocks, e.g., at the end of a statement.
+ */
+void BTreeIndex::flush() {
+    if (!this->closed)
+        this->file->flush();
+}
+
+/**
+ * Find the rows with the given key.
+ * @param key_values  a value for each of the key columns
+ * @return            handles of the rows (freed by caller)
+ */
+Handles *BTreeIndex::lookup(ValueDict *key_values) const {
+    if (key_value(key_values).size() != this->key_columns.size())
+        throw DbRelationError("lookup in index " + this->name + " needs a value for every key column");
+    return range(key_values, key_values);
+}
+
+/**
+ * Find the rows whose keys are in a range, by going down to the leaf where the range starts
+ * and then along the leaves until it ends.
+ * @param min_key  lowest key, or nullptr
+ * @param max_key  highest key, or nullptr
+ * @return         handles of the rows in key order (freed by caller)
+ */
+Handles *BTreeIndex::range(ValueDict *min_key, ValueDict *max_key) const {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    BTreeKey start(min_key == nullptr ? KeyValue() : key_value(min_key), Handle(0, 0));  // before any row's handle
+    KeyValue end = max_key == nullptr ? KeyValue() : key_value(max_key);
+    Handles *handles = new Handles();
+    try {
+        BlockID leaf_id = find_leaf(start);
+        while (leaf_id != 0) {
+            BTreeLeaf leaf(*this->file, leaf_id, this->key_profile);
+            const vector<BTreeKey> &keys = leaf.get_keys();
+            for (uint i = leaf.find(start); i < keys.size(); i++) {
+                if (max_key != nullptr && BTreeNode::compare(keys[i].first, end) > 0)
+                    return handles;
+                handles->push_back(keys[i].second);
+            }
+            leaf_id = leaf.get_next_leaf();
+        }
+    } catch (...) {
+        delete handles;
+        throw;
+    }
+    return handles;
+}
+
+/**
+ * Add the entry for a row, splitting nodes on the way back up as needed. If the root splits,
+ * a new root goes on top of the two halves (see insert_key).
+ * @param record  handle of the row (must be in the relation)
+ * @throws        DbRelationError if the index is unique and the row's key is already there
+ */
+void BTreeIndex::insert(Handle record) {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    BTreeKey key = key_of(record);
+    if (this->unique && has_key(key.first))
+        throw DbRelationError("duplicate key in unique index " + this->name);
+    insert_key(key);
+}
+
+/**
+ * Add the entries for several rows. They are sorted, then for the first one not yet added
+ * we go down to its leaf, noting the boundary where the next leaf starts, and merge in all
+ * the entries before that boundary at once. If they don't all fit, just the first goes in
+ * the usual way (splitting the leaf) and the rest are grouped again.
+ * @param records  handles of the rows (must be in the relation)
+ * @throws         DbRelationError if the index is unique and a key is already there or comes
+ *                 twice (then none of the entries are added)
+ */
+void BTreeIndex::insert_batch(const Handles *records) {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    vector<BTreeKey> keys;
+    keys.reserve(records->size());
+    for (auto const &record: *records)
+        keys.push_back(key_of(record));
+    sort(keys.begin(), keys.end(), [](const BTreeKey &a, const BTreeKey &b) { return BTreeNode::compare(a, b) < 0; });
+    if (this->unique)
+        for (uint i = 0; i < keys.size(); i++)
+            if ((i > 0 && BTreeNode::compare(keys[i].first, keys[i - 1].first) == 0) || has_key(keys[i].first))
+                throw DbRelationError("duplicate key in unique index " + this->name);
+
+    uint i = 0;
+    while (i < keys.size()) {
+        BTreeKey fence;
+        bool bounded;
+        BlockID leaf_id = find_leaf(keys[i], fence, bounded);
+        uint end = i + 1;
+        while (end < keys.size() && (!bounded || BTreeNode::compare(keys[end], fence) < 0))
+            end++;
+        BTreeLeaf leaf(*this->file, leaf_id, this->key_profile);
+        if (leaf.insert_all(keys.begin() + i, keys.begin() + end)) {
+            i = end;
+        } else {
+            insert_key(keys[i]);
+            i++;
+        }
+    }
+}
+
+/**
+ * Add an entry, splitting nodes on the way back up as needed.
+ * @param key  key and handle of the row
+ */
+void BTreeIndex::insert_key(const BTreeKey &key) {
+    Insertion split = insert(this->root_id, 1, key);
+    if (split.second != 0) {
+        BTreeInterior root(*this->file, this->key_profile);
+        root.set_first(this->root_id);
+        root.append(split);
+        root.save();
+        this->root_id = root.get_block_id();
+        this->height++;
+        write_stat();
+    }
+}
+
+/**
+ * Remove the entry for a row.
+ * @param record  handle of the row (must still be in the relation)
+ */
+void BTreeIndex::del(Handle record) {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    BTreeKey key = key_of(record);
+    BTreeLeaf leaf(*this->file, find_leaf(key), this->key_profile);
+    leaf.del(key);
+}
+
+/**
+ * Build the tree bottom-up from keys in order. The leaves are filled left to right to
+ * FILL_FACTOR and linked up; then each level of interior nodes is filled the same way over the
+ * first keys of the nodes on the level below, until a level is just one node, the root.
+ * @param sorter  the keys (finished)
+ * @throws        DbRelationError if the index is unique and two rows have the same key
+ */
+void BTreeIndex::build(KeySorter &sorter) {
+    const uint empty = 1 + sizeof(BlockID);  // marshalled size of a node with no entries
+    vector<Insertion> level;  // first key and block of each node on the level just built
+    BTreeLeaf *leaf = new BTreeLeaf(*this->file, this->key_profile);
+    uint limit = leaf->capacity() * FILL_FACTOR / 100;
+    uint size = empty;
+    level.push_back(Insertion(BTreeKey(), leaf->get_block_id()));
+    try {
+        BTreeKey key, previous;
+        for (bool first = true; sorter.next(key); first = false) {
+            if (this->unique && !first && BTreeNode::compare(key.first, previous.first) == 0)
+                throw DbRelationError("duplicate key in unique index " + this->name);
+            uint key_size = BTreeNode::key_size(this->key_profile, key);
+            if (size > empty && size + key_size > limit) {
+                BTreeLeaf *next = new BTreeLeaf(*this->file, this->key_profile);
+                leaf->set_next_leaf(next->get_block_id());
+                leaf->save();
+                delete leaf;
+                leaf = next;
+                level.push_back(Insertion(key, leaf->get_block_id()));
+                size = empty;
+            }
+            leaf->append(key);
+            size += key_size;
+            previous = key;
+        }
+        leaf->save();
+    } catch (...) {
+        delete leaf;
+        throw;
+    }
+    delete leaf;
+
+    this->height = 1;
+    while (level.size() > 1) {
+        vector<Insertion> parents;
+        BTreeInterior *node = nullptr;
+        try {
+            for (auto const &child: level) {
+                if (node != nullptr) {
+                    uint entry_size = BTreeNode::key_size(this->key_profile, child.first) + sizeof(BlockID);
+                    if (size + entry_size <= limit) {
+                        node->append(child);
+                        size += entry_size;
+                        continue;
+                    }
+                    node->save();
+                    delete node;
+                    node = nullptr;
+                }
+                node = new BTreeInterior(*this->file, this->key_profile);
+                node->set_first(child.second);
+                parents.push_back(Insertion(child.first, node->get_block_id()));
+                size = empty;
+            }
+            node->save();
+        } catch (...) {
+            delete node;
+            throw;
+        }
+        delete node;
+        level.swap(parents);
+        this->height++;
+    }
+    this->root_id = level[0].second;
+    write_stat();
+}
+
+/**
+ * Pull the key columns' values out of a row or search key, in index order. Stops at the first
+ * key column that isn't there, so a partial key gives just the leading values.
+ * @param key_values  values by column name
+ * @return            key values
+ */
+KeyValue BTreeIndex::key_value(const ValueDict *key_values) const {
+    KeyValue values;
+    for (auto const &column_name: this->key_columns) {
+        ValueDict::const_iterator found = key_values->find(column_name);
+        if (found == key_values->end())
+            break;
+        values.push_back(found->second);
+    }
+    return values;
+}
+
+/**
+ * Get the full index entry key for a row.
+ * @param record  handle of the row
+ * @return        its key values and handle
+ */
+BTreeKey BTreeIndex::key_of(Handle record) const {
+    ValueDict *row = this->relation.project(record, &this->key_columns);
+    BTreeKey key(key_value(row), record);
+    delete row;
+    return key;
+}
+
+/**
+ * Go down from the root to the leaf where the given key is or would go.
+ * @param key  key to look for
+ * @return     leaf block id
+ */
+BlockID BTreeIndex::find_leaf(const BTreeKey &key) const {
+    BlockID node_id = this->root_id;
+    for (uint depth = 1; depth < this->height; depth++) {
+        BTreeInterior node(*this->file, node_id, this->key_profile);
+        node_id = node.find(key);
+    }
+    return node_id;
+}
+
+/**
+ * Go down from the root to the leaf where the given key is or would go, noting the nearest
+ * boundary after it on the way: every key in the leaf comes before that.
+ * @param key      key to look for
+ * @param fence    set to the first key of the next leaf's subtree, if there is one
+ * @param bounded  set to false if the leaf is the last one
+ * @return         leaf block id
+ */
+BlockID BTreeIndex::find_leaf(const BTreeKey &key, BTreeKey &fence, bool &bounded) const {
+    BlockID node_id = this->root_id;
+    bounded = false;
+    for (uint depth = 1; depth < this->height; depth++) {
+        BTreeInterior node(*this->file, node_id, this->key_profile);
+        BTreeKey next;
+        bool has_next;
+        node_id = node.find(key, next, has_next);
+        if (has_next) {
+            fence = next;
+            bounded = true;
+        }
+    }
+    return node_id;
+}
+
+/**
+ * Check whether any row has the given key values.
+ * @param key_value  values of all the key columns
+ * @return           true if there is an entry with them
+ */
+bool BTreeIndex::has_key(const KeyValue &key_value) const {
+    BTreeKey start(key_value, Handle(0, 0));  // before any row's handle
+    BlockID leaf_id = find_leaf(start);
+    while (leaf_id != 0) {
+        BTreeLeaf leaf(*this->file, leaf_id, this->key_profile);
+        const vector<BTreeKey> &keys = leaf.get_keys();
+        uint i = leaf.find(start);
+        if (i < keys.size())
+            return BTreeNode::compare(keys[i].first, key_value) == 0;
+        leaf_id = leaf.get_next_leaf();  // the leaf may end just before it (or be empty from deletes)
+    }
+    return false;
+}
+
+/**
+ * Add a key in the subtree under a node.
+ * @param node_id  root of the subtree
+ * @param depth    level of the node (the root is 1, the leaves are height)
+ * @param key      key to add
+ * @return         the node's split for its parent to add, or a block of 0 if it didn't split
+ */
+Insertion BTreeIndex::insert(BlockID node_id, uint depth, const BTreeKey &key) {
+    if (depth == this->height) {
+        BTreeLeaf leaf(*this->file, node_id, this->key_profile);
+        return leaf.insert(key);
+    }
+    BTreeInterior node(*this->file, node_id, this->key_profile);
+    Insertion split = insert(node.find(key), depth + 1, key);
+    if (split.second == 0)
+        return split;
+    return node.insert(split);
+}
+
+/**
+ * Read the root block id and height from the first block.
+ */
+void BTreeIndex::read_stat() {
+    SlottedPage *page = this->file->get(this->stat_id);
+    RecordView record = page->view(1);
+    uint32_t stat[2];
+    bool ok = record.data != nullptr && record.size == sizeof(stat);
+    if (ok)
+        memcpy(stat, record.data, sizeof(stat));
+    delete page;
+    if (!ok)
+        throw DbRelationError("index " + this->name + " has no root");
+    this->root_id = stat[0];
+    this->height = stat[1];
+}
+
+/**
+ * Write the root block id and height to the first block.
+ */
+void BTreeIndex::write_stat() {
+    uint32_t stat[2] = {this->root_id, this->height};
+    Dbt data(stat, sizeof(stat));
+    SlottedPage *page = this->file->get(this->stat_id);
+    try {
+        if (page->next_id(0) == 0)
+            page->add(&data);
+        else
+            page->put(1, data);
+        this->file->put(page);
+    } catch (...) {
+        delete page;
+        throw;
+    }
+    delete page;
+}
+
+
+// test function -- returns true if all tests pass
+bool test_btree() {
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    HeapTable table("_test_btree_cpp", column_names, column_attributes);
+    table.create();
+
+    // long keys so a couple thousand rows make a tree three levels high
+    string padding(200, '.');
+    ValueDict row;
+    Handles inserted;
+    for (int i = 0; i < 2000; i++) {
+        row["a"] = Value(i);
+        row["b"] = Value(padding + to_string(i % 37));
+        inserted.push_back(table.insert(&row));
+    }
+
+    ColumnNames key_a;
+    key_a.push_back("a");
+    BTreeIndex index(table, "fxa", key_a, true);
+    index.set_sort_memory(64 * 1024);  // small enough that the build sorts in several runs
+    index.create();
+    ValueDict key;
+    for (int i = 0; i < 2000; i += 7) {
+        key["a"] = Value(i);
+        Handles *handles = index.lookup(&key);
+        bool ok = handles->size() == 1 && (*handles)[0] == inserted[i];
+        delete handles;
+        if (!ok)
+            return assertion_failure("lookup", i);
+    }
+    key["a"] = Value(2000);
+    Handles *handles = index.lookup(&key);
+    if (!handles->empty())
+        return assertion_failure("lookup of missing key", (double) handles->size());
+    delete handles;
+    cout << "btree lookup ok" << endl;
+
+    for (int i = 2000; i < 2500; i++) {
+        row["a"] = Value(i);
+        row["b"] = Value(padding + to_string(i % 37));
+        Handle handle = table.insert(&row);
+        inserted.push_back(handle);
+        index.insert(handle);
+    }
+    row["a"] = Value(1234);
+    Handle duplicate = table.insert(&row);
+    try {
+        index.insert(duplicate);
+        return assertion_failure("duplicate key not caught");
+    } catch (DbRelationError &e) {
+        table.del(duplicate);
+    }
+    ValueDict min_key, max_key;
+    min_key["a"] = Value(1990);
+    max_key["a"] = Value(2109);
+    handles = index.range(&min_key, &max_key);
+    bool ok = handles->size() == 120;
+    for (uint i = 0; ok && i < handles->size(); i++)
+        ok = (*handles)[i] == inserted[1990 + i];
+    delete handles;
+    if (!ok)
+        return assertion_failure("range");
+    cout << "btree insert/range ok" << endl;
+
+    ColumnNames key_ba;
+    key_ba.push_back("b");
+    key_ba.push_back("a");
+    BTreeIndex composite(table, "fxba", key_ba, false);
+    composite.create();
+    min_key.clear();
+    min_key["b"] = Value(padding + "5");
+    handles = composite.range(&min_key, &min_key);
+    ok = handles->size() == 2500 / 37 + 1;
+    for (uint i = 0; ok && i < handles->size(); i++)
+        ok = (*handles)[i] == inserted[5 + 37 * i];  // sorted by a within the same b
+    delete handles;
+    if (!ok)
+        return assertion_failure("composite range");
+    try {
+        composite.lookup(&min_key);
+        return assertion_failure("partial key lookup not caught");
+    } catch (DbRelationError &e) {
+    }
+    ColumnNames key_b;
+    key_b.push_back("b");
+    BTreeIndex not_unique(table, "fxb", key_b, true);
+    try {
+        not_unique.create();
+        return assertion_failure("duplicate key not caught by bulk build");
+    } catch (DbRelationError &e) {
+    }
+    cout << "btree composite key ok" << endl;
+
+    for (int i = 0; i < 2500; i += 2) {
+        index.del(inserted[i]);
+        composite.del(inserted[i]);
+        table.del(inserted[i]);
+    }
+    handles = index.range(nullptr, nullptr);
+    ok = handles->size() == 1250;
+    delete handles;
+    index.close();
+    BTreeIndex reopened(table, "fxa", key_a, true);
+    reopened.open();
+    key["a"] = Value(1235);
+    handles = reopened.lookup(&key);
+    ok = ok && handles->size() == 1 && (*handles)[0] == inserted[1235];
+    delete handles;
+    key["a"] = Value(1234);
+    handles = reopened.lookup(&key);
+    ok = ok && handles->empty();
+    delete handles;
+    if (!ok)
+        return assertion_failure("del/reopen");
+    cout << "btree del/reopen ok" << endl;
+
+    // the table keeps the indices up to date
+    table.add_index(&reopened);
+    table.add_index(&composite);
+    ValueDicts batch;
+    for (int i = 3000; i < 3300; i++) {
+        ValueDict *batch_row = new ValueDict();
+        (*batch_row)["a"] = Value(i);
+        (*batch_row)["b"] = Value(padding + to_string(i % 37));
+        batch.push_back(batch_row);
+    }
+    handles = table.insert_batch(&batch);
+    for (auto const &batch_row: batch)
+        delete batch_row;
+    Handles added = *handles;
+    delete handles;
+    min_key.clear();
+    min_key["a"] = Value(3000);
+    max_key.clear();
+    max_key["a"] = Value(3299);
+    handles = reopened.range(&min_key, &max_key);
+    ok = *handles == added;
+    delete handles;
+    uint64_t rows = table.get_row_count();
+    row["a"] = Value(3100);
+    try {
+        table.insert(&row);
+        ok = false;
+    } catch (DbRelationError &e) {
+    }
+    ok = ok && table.get_row_count() == rows;
+    for (int i = 0; i < 3; i++) {  // a bad row, then a key the unique index already has
+        ValueDict *batch_row = new ValueDict();
+        (*batch_row)["a"] = Value(3400 + i);
+        (*batch_row)["b"] = Value("x");
+        batch[i] = batch_row;
+    }
+    batch.resize(3);
+    batch[2]->erase("b");
+    for (int attempt = 0; attempt < 2; attempt++) {
+        try {
+            delete table.insert_batch(&batch);
+            ok = false;
+        } catch (DbRelationError &e) {
+        }
+        ok = ok && table.get_row_count() == rows;
+        (*batch[2])["b"] = Value("x");
+        (*batch[2])["a"] = Value(3100);
+    }
+    for (auto const &batch_row: batch)
+        delete batch_row;
+    min_key.clear();
+    min_key["a"] = Value(3400);
+    max_key["a"] = Value(3402);
+    handles = reopened.range(&min_key, &max_key);
+    ok = ok && handles->empty();
+    delete handles;
+    table.del(added[1]);
+    try {
+        table.del(added[1]);
+        ok = false;
+    } catch (DbRelationError &e) {
+    }
+    key["a"] = Value(3001);
+    handles = reopened.lookup(&key);
+    ok = ok && handles->empty();
+    delete handles;
+    min_key.clear();
+    min_key["b"] = Value(padding + to_string(3001 % 37));
+    handles = composite.range(&min_key, &min_key);
+    ok = ok && find(handles->begin(), handles->end(), added[1]) == handles->end()
+         && find(handles->begin(), handles->end(), added[38]) != handles->end();
+    delete handles;
+    BTreeIndex missing(table, "fxmissing", key_a, false);  // never created, so it can't open
+    table.add_index(&missing);
+    row["a"] = Value(3500);
+    try {
+        table.insert(&row);
+        ok = false;
+    } catch (exception &e) {
+        ok = ok && string(e.what()).find("not open") == string::npos;  // the open's own error
+    }
+    table.remove_index(&missing);
+    key["a"] = Value(3500);
+    handles = reopened.lookup(&key);
+    ok = ok && handles->empty() && table.get_row_count() == rows - 1;
+    delete handles;
+    table.remove_index(&reopened);
+    table.remove_index(&composite);
+    if (!ok)
+        return assertion_failure("index maintenance");
+    cout << "btree index maintenance ok" << endl;
+
+    reopened.drop();
+    composite.drop();
+
+    row["a"] = Value(5000);
+    row["b"] = Value(string(70000, 'x'));  // more than a u16 length can say
+    table.insert(&row);
+    BTreeIndex too_big(table, "fxb", key_b, false);
+    too_big.set_sort_memory(64 * 1024);
+    try {
+        too_big.create();
+        return assertion_failure("key too big not caught");
+    } catch (DbRelationError &e) {
+        if (string(e.what()) != "key too big to index")
+            return assertion_failure(e.what());
+    }
+    cout << "btree key too big ok" << endl;
+
+    table.drop();
+    return true;
+}
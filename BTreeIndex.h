@@ -0,0 +1,117 @@
+/**
+ * @file BTreeIndex.h - Implementation of DbIndex with a B+tree.
+ * BTreeIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include "storage_engine.h"
+#include "HeapFile.h"
+#include "BTreeNode.h"
+#include "KeySorter.h"
+
+/**
+ * @class BTreeIndex - B+tree index (implementation of DbIndex)
+ *
+ * The tree is kept in a HeapFile of its own named <table>-<index>, one node per block (see
+ * BTreeNode). The first block holds the id of the root block and the height of the tree. Keys
+ * are the values of the key columns from _indices, in order, so composite keys sort by their
+ * first column, then their second, and so on. Every entry also carries the handle of its row,
+ * which keeps the entries distinct even when the index isn't unique.
+ *
+ * Creating the index on a table that already has rows builds the tree bottom-up: the keys are
+ * sorted (spilling to disk if they don't fit in memory, see KeySorter), packed into leaves in
+ * order, and the interior levels are built over the leaves the same way.
+ *
+ * The index must be created or opened before it is used. Leaves are not merged when deletes
+ * leave them small.
+ */
+class BTreeIndex : public DbIndex {
+public:
+    /**
+     * How full, in percent of a block, a bulk build packs the nodes (leaving room for inserts)
+     */
+    static const uint FILL_FACTOR = 90;
+
+    BTreeIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique);
+
+    virtual ~BTreeIndex();
+
+    BTreeIndex(const BTreeIndex &other) = delete;
+
+    BTreeIndex(BTreeIndex &&temp) = delete;
+
+    BTreeIndex &operator=(const BTreeIndex &other) = delete;
+
+    BTreeIndex &operator=(BTreeIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual void flush();
+
+    virtual Handles *lookup(ValueDict *key_values) const;
+
+    /**
+     * Lookup a range of search keys. A key given only for the first few key columns covers
+     * every key that starts with those values.
+     * @param min_key  dictionary of min (inclusive) search key, or nullptr for no minimum
+     * @param max_key  dictionary of max (inclusive) search key, or nullptr for no maximum
+     * @returns        list of DbFile handles for records in range, in key order (freed by caller)
+     */
+    virtual Handles *range(ValueDict *min_key, ValueDict *max_key) const;
+
+    virtual void insert(Handle record);
+
+    /**
+     * Insert the entries for several records: sorted, and added a leaf's worth at a time, so
+     * each leaf is read and written once unless it has to split.
+     * @param records  handles of the records (must be in the relation)
+     */
+    virtual void insert_batch(const Handles *records);
+
+    virtual void del(Handle record);
+
+    /**
+     * Set how much memory create may use to sort the keys before it spills runs to disk.
+     * @param bytes  memory budget
+     */
+    virtual void set_sort_memory(uint bytes) { sort_memory = bytes; }
+
+protected:
+    HeapFile *file;
+    bool closed;
+    BlockID stat_id;  // block holding the root id and height
+    BlockID root_id;
+    uint height;      // 1 when the root is a leaf
+    KeyProfile key_profile;
+    uint sort_memory;
+
+    virtual void build(KeySorter &sorter);
+
+    virtual KeyValue key_value(const ValueDict *key_values) const;
+
+    virtual BTreeKey key_of(Handle record) const;
+
+    virtual BlockID find_leaf(const BTreeKey &key) const;
+
+    virtual BlockID find_leaf(const BTreeKey &key, BTreeKey &fence, bool &bounded) const;
+
+    virtual bool has_key(const KeyValue &key_value) const;
+
+    virtual void insert_key(const BTreeKey &key);
+
+    virtual Insertion insert(BlockID node_id, uint depth, const BTreeKey &key);
+
+    virtual void read_stat();
+
+    virtual void write_stat();
+};
+
+bool test_btree();
@@ -0,0 +1,403 @@
+/**
+ * @file BTreeNode.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include "BTreeNode.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+/**
+ * Compare two keys column by column, then by handle.
+ * @param a  a key
+ * @param b  another key
+ * @return   negative if a comes first, positive if b does, 0 if they are the same
+ */
+int BTreeNode::compare(const BTreeKey &a, const BTreeKey &b) {
+    int result = compare(a.first, b.first);
+    if (result != 0)
+        return result;
+    if (a.second == b.second)
+        return 0;
+    return a.second < b.second ? -1 : 1;
+}
+
+/**
+ * Compare just the key values of two keys. INT and BOOLEAN values compare as numbers and TEXT
+ * values byte by byte.
+ * @param a  key values
+ * @param b  more key values
+ * @return   negative, zero or positive like compare
+ */
+int BTreeNode::compare(const KeyValue &a, const KeyValue &b) {
+    for (uint i = 0; i < a.size() && i < b.size(); i++) {
+        if (a[i].data_type == ColumnAttribute::TEXT) {
+            int result = a[i].s.compare(b[i].s);
+            if (result != 0)
+                return result;
+        } else if (a[i].n != b[i].n) {
+            return a[i].n < b[i].n ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Constructor for a node already in the file (the subclass reads it in with load).
+ * @param file      the index file
+ * @param block_id  block holding the node
+ * @param profile   types of the key columns
+ */
+BTreeNode::BTreeNode(HeapFile &file, BlockID block_id, const KeyProfile &profile)
+        : file(file), profile(profile), block_id(block_id), pointer(0), keys(), children() {
+}
+
+/**
+ * Constructor for a new node, which gets a block of its own right away.
+ * @param file     the index file
+ * @param profile  types of the key columns
+ */
+BTreeNode::BTreeNode(HeapFile &file, const KeyProfile &profile)
+        : file(file), profile(profile), block_id(0), pointer(0), keys(), children() {
+    SlottedPage *page = file.get_new();
+    this->block_id = page->get_block_id();
+    delete page;
+}
+
+/**
+ * Write the node into its block, replacing what was there.
+ */
+void BTreeNode::save() {
+    string bytes;
+    marshal(bytes);
+    if (bytes.size() > capacity())
+        throw DbBlockNoRoomError("index node does not fit in its block");
+    Dbt data(&bytes[0], (u_int32_t) bytes.size());
+    SlottedPage *page = this->file.get(this->block_id);
+    try {
+        if (page->next_id(0) == 0)
+            page->add(&data);
+        else
+            page->put(1, data);
+        this->file.put(page);
+    } catch (...) {
+        delete page;
+        throw;
+    }
+    delete page;
+}
+
+/**
+ * Read the node in from its block.
+ * @throws DbRelationError if the block doesn't hold the kind of node expected
+ */
+void BTreeNode::load() {
+    SlottedPage *page = this->file.get(this->block_id);
+    try {
+        RecordView record = page->view(1);
+        if (record.data == nullptr || record.size < 5 || record.data[0] != kind())
+            throw DbRelationError("index block " + to_string(this->block_id) + " is not the node expected");
+        memcpy(&this->pointer, record.data + 1, sizeof(BlockID));
+        uint offset = 5;
+        while (offset < record.size) {
+            BTreeKey key;
+            offset += unmarshal_key(this->profile, record.data + offset, key);
+            this->keys.push_back(key);
+            if (kind() == INTERIOR) {
+                BlockID child;
+                memcpy(&child, record.data + offset, sizeof(BlockID));
+                offset += sizeof(BlockID);
+                this->children.push_back(child);
+            }
+        }
+    } catch (...) {
+        delete page;
+        throw;
+    }
+    delete page;
+}
+
+/**
+ * Most bytes a node can marshal to and still be the one record in its block.
+ * @return capacity in bytes
+ */
+uint BTreeNode::capacity() const {
+    return this->file.get_block_size() - 16;  // block header, one record header, and some slack
+}
+
+/**
+ * Biggest key a node will take.
+ * @param file  the index file
+ * @return      size in bytes
+ */
+uint BTreeNode::max_key_size(const HeapFile &file) {
+    return (file.get_block_size() - 16) / 4;
+}
+
+/**
+ * Bytes the node would marshal to as it is now.
+ * @return size in bytes
+ */
+uint BTreeNode::marshalled_size() const {
+    uint size = 1 + sizeof(BlockID);
+    for (auto const &key: this->keys)
+        size += key_size(this->profile, key) + (kind() == INTERIOR ? sizeof(BlockID) : 0);
+    return size;
+}
+
+/**
+ * Bytes one key marshals to.
+ * @param profile  types of the key columns
+ * @param key      the key
+ * @return     size in bytes
+ */
+uint BTreeNode::key_size(const KeyProfile &profile, const BTreeKey &key) {
+    uint size = sizeof(BlockID) + sizeof(RecordID);
+    for (uint i = 0; i < profile.size(); i++) {
+        if (profile[i] == ColumnAttribute::INT)
+            size += sizeof(int32_t);
+        else if (profile[i] == ColumnAttribute::TEXT)
+            size += sizeof(u16) + (uint) key.first[i].s.size();
+        else
+            size += sizeof(uint8_t);
+    }
+    return size;
+}
+
+/**
+ * Marshal the whole node.
+ * @param bytes  appended to
+ */
+void BTreeNode::marshal(string &bytes) const {
+    bytes.reserve(marshalled_size());
+    bytes.push_back(kind());
+    bytes.append((const char *) &this->pointer, sizeof(BlockID));
+    for (uint i = 0; i < this->keys.size(); i++) {
+        marshal_key(this->profile, this->keys[i], bytes);
+        if (kind() == INTERIOR)
+            bytes.append((const char *) &this->children[i], sizeof(BlockID));
+    }
+}
+
+/**
+ * Marshal one key.
+ * @param profile  types of the key columns
+ * @param key      the key
+ * @param bytes    appended to
+ */
+void BTreeNode::marshal_key(const KeyProfile &profile, const BTreeKey &key, string &bytes) {
+    for (uint i = 0; i < profile.size(); i++) {
+        const Value &value = key.first[i];
+        if (profile[i] == ColumnAttribute::INT) {
+            bytes.append((const char *) &value.n, sizeof(int32_t));
+        } else if (profile[i] == ColumnAttribute::TEXT) {
+            u16 size = (u16) value.s.size();
+            bytes.append((const char *) &size, sizeof(u16));
+            bytes.append(value.s);
+        } else {
+            bytes.push_back((char) value.n);
+        }
+    }
+    bytes.append((const char *) &key.second.first, sizeof(BlockID));
+    bytes.append((const char *) &key.second.second, sizeof(RecordID));
+}
+
+/**
+ * Unmarshal one key.
+ * @param profile  types of the key columns
+ * @param bytes    where it starts
+ * @param key      set to the key
+ * @return         bytes it took up
+ */
+uint BTreeNode::unmarshal_key(const KeyProfile &profile, const char *bytes, BTreeKey &key) {
+    uint offset = 0;
+    key.first.clear();
+    for (uint i = 0; i < profile.size(); i++) {
+        Value value;
+        if (profile[i] == ColumnAttribute::INT) {
+            memcpy(&value.n, bytes + offset, sizeof(int32_t));
+            offset += sizeof(int32_t);
+        } else if (profile[i] == ColumnAttribute::TEXT) {
+            u16 size;
+            memcpy(&size, bytes + offset, sizeof(u16));
+            offset += sizeof(u16);
+            value = Value(string(bytes + offset, size));
+            offset += size;
+        } else {
+            value.n = (uint8_t) bytes[offset];
+            value.data_type = ColumnAttribute::BOOLEAN;
+            offset += sizeof(uint8_t);
+        }
+        key.first.push_back(value);
+    }
+    memcpy(&key.second.first, bytes + offset, sizeof(BlockID));
+    offset += sizeof(BlockID);
+    memcpy(&key.second.second, bytes + offset, sizeof(RecordID));
+    offset += sizeof(RecordID);
+    return offset;
+}
+
+/**
+ * Position of the first key at or after the given one (binary search).
+ * @param key  key to look for
+ * @return     index into the keys (their number if all of them come before key)
+ */
+uint BTreeLeaf::find(const BTreeKey &key) const {
+    return (uint) (lower_bound(this->keys.begin(), this->keys.end(), key,
+                               [](const BTreeKey &a, const BTreeKey &b) { return compare(a, b) < 0; })
+                   - this->keys.begin());
+}
+
+/**
+ * Add a key in order. If the leaf is then too big, the upper half of the keys move to a new
+ * leaf that is linked in after this one.
+ * @param key  the key
+ * @return     first key and block of the new leaf, or a block of 0 if there was no split
+ * @throws     DbRelationError if the key is too big to index
+ */
+Insertion BTreeLeaf::insert(const BTreeKey &key) {
+    if (key_size(this->profile, key) > max_key_size(this->file))
+        throw DbRelationError("key too big to index");
+    this->keys.insert(this->keys.begin() + find(key), key);
+    if (!overfull()) {
+        save();
+        return Insertion(BTreeKey(), 0);
+    }
+    BTreeLeaf right(this->file, this->profile);
+    uint half = (uint) this->keys.size() / 2;
+    right.keys.assign(this->keys.begin() + half, this->keys.end());
+    this->keys.resize(half);
+    right.pointer = this->pointer;
+    this->pointer = right.block_id;
+    right.save();
+    save();
+    return Insertion(right.keys[0], right.block_id);
+}
+
+/**
+ * Merge a run of keys in. If the leaf is then too big, put it back the way it was, since the
+ * caller would rather split it one key at a time.
+ * @param begin  first of the keys
+ * @param end    just past the last of them
+ * @return       true if they were added (and the leaf saved)
+ * @throws       DbRelationError if one of the keys is too big to index
+ */
+bool BTreeLeaf::insert_all(vector<BTreeKey>::const_iterator begin, vector<BTreeKey>::const_iterator end) {
+    for (vector<BTreeKey>::const_iterator key = begin; key != end; key++)
+        if (key_size(this->profile, *key) > max_key_size(this->file))
+            throw DbRelationError("key too big to index");
+    vector<BTreeKey> merged;
+    merged.reserve(this->keys.size() + (end - begin));
+    merge(this->keys.begin(), this->keys.end(), begin, end, back_inserter(merged),
+          [](const BTreeKey &a, const BTreeKey &b) { return compare(a, b) < 0; });
+    this->keys.swap(merged);
+    if (overfull()) {
+        this->keys.swap(merged);
+        return false;
+    }
+    save();
+    return true;
+}
+
+/**
+ * Add a key at the end, leaving it to the caller to keep the leaf from overfilling.
+ * @param key  the key
+ * @throws     DbRelationError if the key is too big to index
+ */
+void BTreeLeaf::append(const BTreeKey &key) {
+    if (key_size(this->profile, key) > max_key_size(this->file))
+        throw DbRelationError("key too big to index");
+    this->keys.push_back(key);
+}
+
+/**
+ * Remove a key.
+ * @param key  the key
+ * @return     true if it was in this leaf
+ */
+bool BTreeLeaf::del(const BTreeKey &key) {
+    uint i = find(key);
+    if (i == this->keys.size() || compare(this->keys[i], key) != 0)
+        return false;
+    this->keys.erase(this->keys.begin() + i);
+    save();
+    return true;
+}
+
+/**
+ * Find the child whose keys the given key falls among: the one after the last boundary that
+ * is not past the key.
+ * @param key  key to look for
+ * @return     child block id
+ */
+BlockID BTreeInterior::find(const BTreeKey &key) const {
+    uint i = position(key);
+    return i == 0 ? this->pointer : this->children[i - 1];
+}
+
+/**
+ * Find the child whose keys the given key falls among, and the boundary where the child after
+ * it starts.
+ * @param key      key to look for
+ * @param fence    set to the following boundary, if there is one
+ * @param bounded  set to false if the child is the last one
+ * @return         child block id
+ */
+BlockID BTreeInterior::find(const BTreeKey &key, BTreeKey &fence, bool &bounded) const {
+    uint i = position(key);
+    bounded = i < this->keys.size();
+    if (bounded)
+        fence = this->keys[i];
+    return i == 0 ? this->pointer : this->children[i - 1];
+}
+
+/**
+ * Add the boundary for a child that split. If the node is then too big, it splits too: the
+ * middle boundary moves up to the parent, its child becomes the new node's leftmost one, and
+ * the boundaries after it go to the new node.
+ * @param split  boundary key and the new child
+ * @return       boundary and block of the new node, or a block of 0 if there was no split
+ */
+Insertion BTreeInterior::insert(const Insertion &split) {
+    uint i = position(split.first);
+    this->keys.insert(this->keys.begin() + i, split.first);
+    this->children.insert(this->children.begin() + i, split.second);
+    if (!overfull()) {
+        save();
+        return Insertion(BTreeKey(), 0);
+    }
+    BTreeInterior right(this->file, this->profile);
+    uint middle = (uint) this->keys.size() / 2;
+    BTreeKey boundary = this->keys[middle];
+    right.pointer = this->children[middle];
+    right.keys.assign(this->keys.begin() + middle + 1, this->keys.end());
+    right.children.assign(this->children.begin() + middle + 1, this->children.end());
+    this->keys.resize(middle);
+    this->children.resize(middle);
+    right.save();
+    save();
+    return Insertion(boundary, right.block_id);
+}
+
+/**
+ * Add a boundary and child at the end.
+ * @param split  boundary key and the child that starts there
+ */
+void BTreeInterior::append(const Insertion &split) {
+    this->keys.push_back(split.first);
+    this->children.push_back(split.second);
+}
+
+/**
+ * Number of boundaries that are not past the given key (binary search).
+ * @param key  key to look for
+ * @return     index of the first boundary after key (their number if there is none)
+ */
+uint BTreeInterior::position(const BTreeKey &key) const {
+    return (uint) (upper_bound(this->keys.begin(), this->keys.end(), key,
+                               [](const BTreeKey &a, const BTreeKey &b) { return compare(a, b) < 0; })
+                   - this->keys.begin());
+}
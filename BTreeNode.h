@@ -0,0 +1,268 @@
+/**
+ * @file BTreeNode.h - Nodes of the B+tree index.
+ * BTreeNode
+ * BTreeLeaf: BTreeNode
+ * BTreeInterior: BTreeNode
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "storage_engine.h"
+#include "HeapFile.h"
+
+typedef std::pair<KeyValue, Handle> BTreeKey;  // a key and the row it is for, so every entry is distinct
+typedef std::pair<BTreeKey, BlockID> Insertion;  // from a split: first key of the new node, and its block
+
+/**
+ * @class BTreeNode - one node of a BTreeIndex
+ *
+ * A node is kept as the only record of one block of the index's HeapFile. The record starts
+ * with a byte saying which kind of node it is and a block id (the next leaf for a leaf, the
+ * leftmost child for an interior node), followed by the entries. Each entry is a marshalled
+ * key (INT 4 bytes, BOOLEAN 1 byte, TEXT a 2-byte length and the bytes), the 6-byte handle of
+ * its row, and for an interior node the 4-byte block id of the child it leads to.
+ *
+ * The whole node is read in when it is constructed (by the subclass, since load() needs to
+ * know the kind) and written back by save(). A node that
+ * grows too big for its block is split by the caller (see BTreeLeaf::insert).
+ */
+class BTreeNode {
+public:
+    /**
+     * Compare two keys column by column, then by handle.
+     * @param a  a key
+     * @param b  another key
+     * @returns  negative if a comes first, positive if b does, 0 if they are the same
+     */
+    static int compare(const BTreeKey &a, const BTreeKey &b);
+
+    /**
+     * Compare just the key values of two keys.
+     * @param a  key values
+     * @param b  more key values
+     * @returns  negative, zero or positive like compare
+     */
+    static int compare(const KeyValue &a, const KeyValue &b);
+
+    /**
+     * Bytes a key takes up in a node.
+     * @param profile  types of the key columns
+     * @param key      the key
+     * @returns        size in bytes
+     */
+    static uint key_size(const KeyProfile &profile, const BTreeKey &key);
+
+    /**
+     * Marshal a key the way nodes hold it.
+     * @param profile  types of the key columns
+     * @param key      the key
+     * @param bytes    appended to
+     */
+    static void marshal_key(const KeyProfile &profile, const BTreeKey &key, std::string &bytes);
+
+    /**
+     * Unmarshal a key marshalled by marshal_key.
+     * @param profile  types of the key columns
+     * @param bytes    where it starts
+     * @param key      set to the key
+     * @returns        bytes it took up
+     */
+    static uint unmarshal_key(const KeyProfile &profile, const char *bytes, BTreeKey &key);
+
+    /**
+     * Read a node that is already in the file.
+     * @param file      the index file
+     * @param block_id  block holding the node
+     * @param profile   types of the key columns
+     */
+    BTreeNode(HeapFile &file, BlockID block_id, const KeyProfile &profile);
+
+    /**
+     * Start a new, empty node in a new block of the file (written by save).
+     * @param file     the index file
+     * @param profile  types of the key columns
+     */
+    BTreeNode(HeapFile &file, const KeyProfile &profile);
+
+    virtual ~BTreeNode() {}
+
+    BTreeNode(const BTreeNode &other) = delete;
+
+    BTreeNode(BTreeNode &&temp) = delete;
+
+    BTreeNode &operator=(const BTreeNode &other) = delete;
+
+    BTreeNode &operator=(BTreeNode &&temp) = delete;
+
+    /**
+     * Write the node back to its block.
+     * @throws DbBlockNoRoomError if it no longer fits
+     */
+    virtual void save();
+
+    /**
+     * Which block the node is in.
+     * @returns  block id
+     */
+    virtual BlockID get_block_id() const { return block_id; }
+
+    /**
+     * Check whether the node has grown past what fits in a block.
+     * @returns  true if it must be split before it is saved
+     */
+    virtual bool overfull() const { return marshalled_size() > capacity(); }
+
+    /**
+     * Most bytes a node can marshal to and still fit in its block.
+     * @returns  capacity in bytes
+     */
+    virtual uint capacity() const;
+
+    /**
+     * Biggest key a node in the file will take, a quarter of a node so each holds several.
+     * @param file  the index file
+     * @returns     size in bytes (see key_size)
+     */
+    static uint max_key_size(const HeapFile &file);
+
+protected:
+    static const char LEAF = 'L';
+    static const char INTERIOR = 'I';
+
+    HeapFile &file;
+    const KeyProfile &profile;
+    BlockID block_id;
+    BlockID pointer;  // next leaf, or leftmost child
+    std::vector<BTreeKey> keys;
+    std::vector<BlockID> children;  // child to the right of each key (interior nodes only)
+
+    virtual char kind() const = 0;
+
+    virtual void load();
+
+    virtual uint marshalled_size() const;
+
+    virtual void marshal(std::string &bytes) const;
+
+};
+
+/**
+ * @class BTreeLeaf - bottom level of the tree: the keys of the rows, in order, and a link to
+ * the next leaf so ranges can be read without going back up the tree
+ */
+class BTreeLeaf : public BTreeNode {
+public:
+    BTreeLeaf(HeapFile &file, BlockID block_id, const KeyProfile &profile) : BTreeNode(file, block_id, profile) {
+        load();
+    }
+
+    BTreeLeaf(HeapFile &file, const KeyProfile &profile) : BTreeNode(file, profile) {}
+
+    virtual ~BTreeLeaf() {}
+
+    /**
+     * Add a key, splitting the leaf if it no longer fits. Both halves are saved.
+     * @param key  the key
+     * @returns    the split for the parent to add, or a block of 0 if there wasn't one
+     */
+    virtual Insertion insert(const BTreeKey &key);
+
+    /**
+     * Add a run of keys at once if they all fit without a split, saving the leaf once.
+     * @param begin  first of the keys (in order)
+     * @param end    just past the last of them
+     * @returns      false, leaving the leaf as it was, if they don't all fit
+     */
+    virtual bool insert_all(std::vector<BTreeKey>::const_iterator begin, std::vector<BTreeKey>::const_iterator end);
+
+    /**
+     * Remove a key (leaves are not merged when they get small).
+     * @param key  the key
+     * @returns    true if it was there
+     */
+    virtual bool del(const BTreeKey &key);
+
+    /**
+     * Add a key at the end, without splitting; for building a leaf up in order.
+     * @param key  the key (no smaller than the last one)
+     * @throws     DbRelationError if the key is too big to index
+     */
+    virtual void append(const BTreeKey &key);
+
+    /**
+     * Position of the first key at or after the given one.
+     * @param key  key to look for
+     * @returns    index into get_keys()
+     */
+    virtual uint find(const BTreeKey &key) const;
+
+    virtual const std::vector<BTreeKey> &get_keys() const { return keys; }
+
+    virtual BlockID get_next_leaf() const { return pointer; }
+
+    virtual void set_next_leaf(BlockID next) { pointer = next; }
+
+protected:
+    virtual char kind() const { return LEAF; }
+};
+
+/**
+ * @class BTreeInterior - upper levels of the tree: boundary keys and the children between them
+ *
+ * Child i + 1 holds the keys from boundary i up to (not including) boundary i + 1; the leftmost
+ * child holds the keys before boundary 0.
+ */
+class BTreeInterior : public BTreeNode {
+public:
+    BTreeInterior(HeapFile &file, BlockID block_id, const KeyProfile &profile)
+            : BTreeNode(file, block_id, profile) {
+        load();
+    }
+
+    BTreeInterior(HeapFile &file, const KeyProfile &profile) : BTreeNode(file, profile) {}
+
+    virtual ~BTreeInterior() {}
+
+    /**
+     * Find the child whose keys the given key falls among.
+     * @param key  key to look for
+     * @returns    child block id
+     */
+    virtual BlockID find(const BTreeKey &key) const;
+
+    /**
+     * Find the child whose keys the given key falls among, and where the next child starts.
+     * @param key      key to look for
+     * @param fence    set to the boundary after the child, if there is one
+     * @param bounded  set to whether there is one (false for the last child)
+     * @returns        child block id
+     */
+    virtual BlockID find(const BTreeKey &key, BTreeKey &fence, bool &bounded) const;
+
+    /**
+     * Add the boundary for a child that split, splitting this node too if it no longer fits.
+     * Both halves are saved.
+     * @param split  boundary key and the new child
+     * @returns      this node's own split for its parent, or a block of 0 if there wasn't one
+     */
+    virtual Insertion insert(const Insertion &split);
+
+    /**
+     * Add a boundary and child at the end, without splitting; for building a node up in order.
+     * @param split  boundary key and the child that starts there
+     */
+    virtual void append(const Insertion &split);
+
+    virtual void set_first(BlockID child) { pointer = child; }
+
+    virtual uint size() const { return (uint) keys.size(); }
+
+protected:
+    virtual char kind() const { return INTERIOR; }
+
+    virtual uint position(const BTreeKey &key) const;
+};
@@ -0,0 +1,309 @@
+/**
+ * @file BufferPool.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "BufferPool.h"
+
+using namespace std;
+
+/**
+ * Get the process-wide pool (constructed on first use).
+ * @return the pool
+ */
+BufferPool &BufferPool::get_pool() {
+    static BufferPool pool;
+    return pool;
+}
+
+/**
+ * Constructor
+ * @param num_frames  how many blocks the pool can hold at once
+ */
+BufferPool::BufferPool(uint num_frames) : frames(num_frames), page_table(), clock_hand(0), stats() {
+    for (uint i = 0; i < num_frames; i++) {
+        BufferFrame &frame = this->frames[i];
+        frame.pool = this;
+        frame.file = nullptr;
+        frame.block_id = 0;
+        frame.pin_count = 0;
+        frame.dirty = false;
+        frame.referenced = false;
+        frame.prefetched = false;
+        frame.loading = false;
+        frame.data = nullptr;  // allocated the first time the frame is used
+        frame.size = 0;
+    }
+}
+
+/**
+ * Destructor. Does not write anything back--files are expected to flush when they are closed.
+ */
+BufferPool::~BufferPool() {
+    for (auto &frame: this->frames)
+        delete[] frame.data;
+}
+
+/**
+ * Pin the frame for the given block, reading it from the file on a miss. If another thread is
+ * reading the block in, wait for it to finish.
+ * @param file      file the block belongs to
+ * @param block_id  which block
+ * @param is_new    if true, don't bother reading the block since the caller will overwrite it
+ * @return          the pinned frame
+ */
+BufferFrame *BufferPool::pin(BufferedFile *file, BlockID block_id, bool is_new) {
+    PageKey key(file, block_id);
+    unique_lock<mutex> lock(this->latch);
+    while (true) {
+        map<PageKey, BufferFrame *>::iterator found = this->page_table.find(key);
+        if (found == this->page_table.end())
+            break;
+        BufferFrame *frame = found->second;
+        if (frame->loading) {
+            this->loaded.wait(lock);  // then look again, since the read may have failed
+            continue;
+        }
+        frame->pin_count++;
+        frame->referenced = true;
+        this->stats.hits++;
+        if (frame->prefetched) {
+            frame->prefetched = false;
+            this->stats.read_ahead_hits++;
+        }
+        return frame;
+    }
+
+    this->stats.misses++;
+    BufferFrame *frame = load(file, block_id);
+    if (!is_new)
+        read_in(lock, file, BlockIDs(1, block_id), vector<BufferFrame *>(1, frame));
+    return frame;
+}
+
+/**
+ * Bring the given blocks into the pool with one call to the file's read_blocks.
+ * @param file       file the blocks belong to
+ * @param block_ids  which blocks
+ */
+void BufferPool::prefetch(BufferedFile *file, const BlockIDs &block_ids) {
+    unique_lock<mutex> lock(this->latch);
+    BlockIDs missing;
+    vector<BufferFrame *> frames;
+    for (auto const &block_id: block_ids) {
+        if (this->page_table.find(PageKey(file, block_id)) != this->page_table.end())
+            continue;
+        BufferFrame *frame;
+        try {
+            frame = load(file, block_id);  // pinned so the rest of the batch can't take it
+        } catch (BufferPoolError &e) {
+            break;  // pool is full of pinned frames; read what we have room for
+        }
+        missing.push_back(block_id);
+        frames.push_back(frame);
+    }
+    if (frames.empty())
+        return;
+    read_in(lock, file, missing, frames);
+    for (auto const &frame: frames) {
+        frame->pin_count = 0;  // nobody else could pin it while it was loading
+        frame->prefetched = true;
+    }
+    this->stats.read_ahead += frames.size();
+}
+
+/**
+ * Add another pin to a frame that is already pinned.
+ * @param frame  frame to pin
+ */
+void BufferPool::pin(BufferFrame *frame) {
+    lock_guard<mutex> lock(this->latch);
+    frame->pin_count++;
+}
+
+/**
+ * Release a pin on the frame. Once unpinned, the frame may be chosen for replacement.
+ * @param frame  frame to unpin
+ */
+void BufferPool::unpin(BufferFrame *frame) {
+    lock_guard<mutex> lock(this->latch);
+    if (frame->pin_count > 0)
+        frame->pin_count--;
+}
+
+/**
+ * Mark the frame dirty so it is written back before it is replaced.
+ * @param frame  frame to mark
+ */
+void BufferPool::mark_dirty(BufferFrame *frame) {
+    lock_guard<mutex> lock(this->latch);
+    frame->dirty = true;
+}
+
+/**
+ * Write back all the dirty frames for the given file (they stay cached).
+ * @param file  file to flush
+ */
+void BufferPool::flush(BufferedFile *file) {
+    lock_guard<mutex> lock(this->latch);
+    map<PageKey, BufferFrame *>::iterator it = this->page_table.lower_bound(PageKey(file, 0));
+    for (; it != this->page_table.end() && it->first.first == file; it++)
+        write_back(it->second);
+}
+
+/**
+ * Write back every dirty frame in the pool.
+ */
+void BufferPool::flush_all() {
+    lock_guard<mutex> lock(this->latch);
+    for (auto &frame: this->frames)
+        write_back(&frame);
+}
+
+/**
+ * Drop all the unpinned frames for the given file without writing them.
+ * Pinned frames are left alone since someone still has a page pointing into them.
+ * @param file  file whose frames are to be forgotten
+ */
+void BufferPool::discard(BufferedFile *file) {
+    lock_guard<mutex> lock(this->latch);
+    map<PageKey, BufferFrame *>::iterator it = this->page_table.lower_bound(PageKey(file, 0));
+    while (it != this->page_table.end() && it->first.first == file) {
+        BufferFrame *frame = it->second;
+        if (frame->pin_count > 0) {
+            it++;
+            continue;
+        }
+        frame->file = nullptr;
+        frame->dirty = false;
+        frame->referenced = false;
+        this->page_table.erase(it++);
+    }
+}
+
+/**
+ * Check whether any of the given file's frames are pinned.
+ * @param file  the file
+ * @return      true if one of them is
+ */
+bool BufferPool::has_pinned(BufferedFile *file) const {
+    lock_guard<mutex> lock(this->latch);
+    map<PageKey, BufferFrame *>::const_iterator it = this->page_table.lower_bound(PageKey(file, 0));
+    for (; it != this->page_table.end() && it->first.first == file; it++)
+        if (it->second->pin_count > 0)
+            return true;
+    return false;
+}
+
+/**
+ * Choose a frame to replace using the clock algorithm: sweep the frames, skipping pinned ones
+ * and giving referenced ones a second chance.
+ * @return  an unpinned frame
+ * @throws  BufferPoolError if all the frames are pinned
+ */
+BufferFrame *BufferPool::victim() {
+    uint n = (uint) this->frames.size();
+    for (uint i = 0; i < 2 * n; i++) {
+        BufferFrame *frame = &this->frames[this->clock_hand];
+        this->clock_hand = (this->clock_hand + 1) % n;
+        if (frame->pin_count > 0)
+            continue;
+        if (frame->referenced) {
+            frame->referenced = false;
+            continue;
+        }
+        return frame;
+    }
+    throw BufferPoolError("all buffer frames are pinned");
+}
+
+/**
+ * Write the frame back to its file if it is dirty.
+ * @param frame  frame to write
+ */
+void BufferPool::write_back(BufferFrame *frame) {
+    if (frame->file == nullptr || !frame->dirty)
+        return;
+    frame->file->write_block(frame->block_id, frame->data);
+    frame->dirty = false;
+    this->stats.writes++;
+}
+
+/**
+ * Empty out the given (unpinned) frame, writing it back first if necessary.
+ * @param frame  frame to evict
+ */
+void BufferPool::evict(BufferFrame *frame) {
+    if (frame->file == nullptr)
+        return;
+    write_back(frame);
+    this->page_table.erase(PageKey(frame->file, frame->block_id));
+    frame->file = nullptr;
+    this->stats.evictions++;
+}
+
+/**
+ * Take a frame for the given block (which must not already be in the pool) and pin it, without
+ * reading anything into it.
+ * @param file      file the block belongs to
+ * @param block_id  which block
+ * @return          the pinned frame, with room for a block of the file
+ * @throws          BufferPoolError if all the frames are pinned
+ */
+BufferFrame *BufferPool::load(BufferedFile *file, BlockID block_id) {
+    BufferFrame *frame = victim();
+    evict(frame);
+    uint block_size = file->get_block_size();
+    if (frame->size < block_size) {
+        delete[] frame->data;
+        frame->data = new char[block_size];
+        frame->size = block_size;
+    }
+    frame->file = file;
+    frame->block_id = block_id;
+    frame->pin_count = 1;
+    frame->dirty = false;
+    frame->referenced = true;
+    frame->prefetched = false;
+    this->page_table[PageKey(file, block_id)] = frame;
+    return frame;
+}
+
+/**
+ * Read blocks into frames just taken by load, letting go of the latch during the read. The
+ * frames are marked as loading meanwhile so other threads wait for them rather than read them
+ * again. If the read fails, the frames are given back.
+ * @param lock       our hold on the latch (held on entry and on return)
+ * @param file       file the blocks belong to
+ * @param block_ids  which blocks
+ * @param frames     the frame for each of them (pinned)
+ */
+void BufferPool::read_in(unique_lock<mutex> &lock, BufferedFile *file, const BlockIDs &block_ids,
+                         const vector<BufferFrame *> &frames) {
+    vector<char *> data;
+    for (auto const &frame: frames) {
+        frame->loading = true;
+        data.push_back(frame->data);
+    }
+    lock.unlock();
+    try {
+        if (block_ids.size() == 1)
+            file->read_block(block_ids[0], data[0]);
+        else
+            file->read_blocks(block_ids, data);
+    } catch (...) {
+        lock.lock();
+        for (auto const &frame: frames) {
+            frame->loading = false;
+            frame->pin_count = 0;
+            this->page_table.erase(PageKey(file, frame->block_id));
+            frame->file = nullptr;
+        }
+        this->loaded.notify_all();
+        throw;
+    }
+    lock.lock();
+    for (auto const &frame: frames)
+        frame->loading = false;
+    this->loaded.notify_all();
+}
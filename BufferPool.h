@@ -0,0 +1,231 @@
+/**
+ * @file BufferPool.h - Page cache in our own process memory, beneath HeapFile.
+ * BufferFrame
+ * BufferPool
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "storage_engine.h"
+
+class BufferPool;  // forward declare
+
+/**
+ * @class BufferPoolError - thrown when the pool cannot find a frame to use
+ */
+class BufferPoolError : public std::runtime_error {
+public:
+    explicit BufferPoolError(std::string s) : runtime_error(s) {}
+};
+
+/**
+ * @class BufferedFile - a file whose blocks can be cached in the BufferPool
+ *
+ * The pool calls back through these to move whole blocks between the file and its frames.
+ */
+class BufferedFile {
+public:
+    virtual ~BufferedFile() {}
+
+    /**
+     * Size of this file's blocks.
+     * @returns  bytes per block
+     */
+    virtual uint get_block_size() const { return DbBlock::BLOCK_SZ; }
+
+protected:
+    /**
+     * Read a whole block from the file.
+     * @param block_id  which block
+     * @param data      where to put it (get_block_size() bytes)
+     */
+    virtual void read_block(BlockID block_id, void *data) = 0;
+
+    /**
+     * Write a whole block to the file.
+     * @param block_id  which block
+     * @param data      the block's bytes (get_block_size() of them)
+     */
+    virtual void write_block(BlockID block_id, const void *data) = 0;
+
+    /**
+     * Read several whole blocks from the file. Files that can overlap the reads override this;
+     * by default they are read one at a time.
+     * @param block_ids  which blocks
+     * @param data       where to put each of them
+     */
+    virtual void read_blocks(const BlockIDs &block_ids, const std::vector<char *> &data) {
+        for (uint i = 0; i < block_ids.size(); i++)
+            read_block(block_ids[i], data[i]);
+    }
+
+    friend class BufferPool;
+};
+
+/**
+ * @class BufferFrame - one block-sized slot of the buffer pool
+ *
+ * A frame holds the in-memory image of one block of one BufferedFile. While pin_count is
+ * nonzero the frame will not be evicted, so its data pointer stays valid.
+ */
+class BufferFrame {
+public:
+    BufferPool *pool;
+    BufferedFile *file;  // nullptr if the frame is unused
+    BlockID block_id;
+    uint pin_count;
+    bool dirty;          // in-memory image differs from what is on disk
+    bool referenced;     // clock bit, set on every pin
+    bool prefetched;     // read ahead by prefetch and not pinned since
+    bool loading;        // being read in (by a thread that let go of the pool's latch to do it)
+    char *data;
+    uint size;           // bytes allocated at data (at least the block size of file)
+};
+
+/**
+ * @struct BufferPoolStats - running counters for the buffer pool
+ */
+struct BufferPoolStats {
+    u_long hits;
+    u_long misses;
+    u_long evictions;
+    u_long writes;
+    u_long read_ahead;       // blocks brought in by prefetch
+    u_long read_ahead_hits;  // of those, ones pinned before being evicted
+};
+
+/**
+ * @class BufferPool - fixed set of page frames with pin/unpin, dirty tracking,
+ * and clock replacement.
+ *
+ * Files may have different block sizes, so each frame's memory is allocated the first time
+ * it is used and grown when it is reused for a file with bigger blocks.
+ *
+ * HeapFile::get/put/get_new go through here, as do the FreeSpaceMap's pages.
+ * A pinned frame is never evicted. Dirty frames are written back when they are
+ * evicted or when their file is flushed (HeapFile::close does this).
+ * Frames are keyed by BufferedFile object, so each physical file should be accessed
+ * through only one live object at a time (otherwise each would cache its own copy).
+ *
+ * The pool can be used from several threads. A latch guards the page table and frame
+ * headers; it is let go while blocks are read in, so threads missing on different blocks read
+ * in parallel, and a thread that wants a block someone else is reading waits for it.
+ */
+class BufferPool {
+public:
+    /**
+     * Default number of frames in the process-wide pool (4MB if all the blocks are 4kB)
+     */
+    static const uint DEFAULT_FRAMES = 1024;
+
+    /**
+     * The process-wide pool that HeapFile and FreeSpaceMap use.
+     * @returns  the pool
+     */
+    static BufferPool &get_pool();
+
+    BufferPool(uint num_frames = DEFAULT_FRAMES);
+
+    virtual ~BufferPool();
+
+    BufferPool(const BufferPool &other) = delete;
+
+    BufferPool(BufferPool &&temp) = delete;
+
+    BufferPool &operator=(const BufferPool &other) = delete;
+
+    BufferPool &operator=(BufferPool &&temp) = delete;
+
+    /**
+     * Pin the frame holding the given block, reading it in from the file if necessary.
+     * @param file      file the block belongs to
+     * @param block_id  which block
+     * @param is_new    true if the caller is going to overwrite the whole block (so skip reading it)
+     * @returns         the pinned frame (caller must unpin)
+     * @throws          BufferPoolError if every frame is pinned
+     */
+    virtual BufferFrame *pin(BufferedFile *file, BlockID block_id, bool is_new = false);
+
+    /**
+     * Bring the given blocks into the pool, unpinned, with one batched read of the ones not
+     * already there, so pinning them afterwards is a hit.
+     * @param file       file the blocks belong to
+     * @param block_ids  which blocks
+     */
+    virtual void prefetch(BufferedFile *file, const BlockIDs &block_ids);
+
+    /**
+     * Pin an already pinned frame again (e.g., when a page object is copied).
+     * @param frame  frame to pin
+     */
+    virtual void pin(BufferFrame *frame);
+
+    /**
+     * Release one pin on the given frame.
+     * @param frame  frame to unpin
+     */
+    virtual void unpin(BufferFrame *frame);
+
+    /**
+     * Note that the frame's contents no longer match what is on disk.
+     * @param frame  frame to mark
+     */
+    virtual void mark_dirty(BufferFrame *frame);
+
+    /**
+     * Write back all the dirty frames for the given file.
+     * @param file  file to flush
+     */
+    virtual void flush(BufferedFile *file);
+
+    /**
+     * Write back all the dirty frames in the pool.
+     */
+    virtual void flush_all();
+
+    /**
+     * Forget all the unpinned frames for the given file without writing them back.
+     * @param file  file whose frames are to be dropped
+     */
+    virtual void discard(BufferedFile *file);
+
+    /**
+     * Check whether any of the given file's frames are pinned.
+     * @param file  the file
+     * @returns     true if someone is still using one of its blocks
+     */
+    virtual bool has_pinned(BufferedFile *file) const;
+
+    /**
+     * Accessor for the pool's running counters.
+     * @returns  stats
+     */
+    virtual const BufferPoolStats &get_stats() const { return stats; }
+
+protected:
+    typedef std::pair<BufferedFile *, BlockID> PageKey;
+
+    std::vector<BufferFrame> frames;
+    std::map<PageKey, BufferFrame *> page_table;
+    uint clock_hand;
+    BufferPoolStats stats;
+    mutable std::mutex latch;
+    std::condition_variable loaded;  // signalled when a frame's read finishes
+
+    virtual BufferFrame *victim();
+
+    virtual void write_back(BufferFrame *frame);
+
+    virtual void evict(BufferFrame *frame);
+
+    virtual BufferFrame *load(BufferedFile *file, BlockID block_id);
+
+    virtual void read_in(std::unique_lock<std::mutex> &lock, BufferedFile *file, const BlockIDs &block_ids,
+                         const std::vector<BufferFrame *> &frames);
+};
@@ -0,0 +1,103 @@
+/**
+ * @file FileManager.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <vector>
+#include "FileManager.h"
+#include "HeapFile.h"
+
+using namespace std;
+
+/**
+ * Get the process-wide manager (constructed on first use).
+ * @return the manager
+ */
+FileManager &FileManager::get_manager() {
+    static FileManager manager;
+    return manager;
+}
+
+/**
+ * Constructor
+ * @param max_open  most heap files to have open at a time
+ */
+FileManager::FileManager(uint max_open) : lru(), positions(), max_open(max_open) {
+}
+
+/**
+ * Put a newly opened file at the front of the list and close the least recently used ones
+ * if we are over the limit.
+ * @param file  the file
+ */
+void FileManager::opened(HeapFile *file) {
+    lock_guard<recursive_mutex> lock(this->latch);
+    used(file);
+    evict(file);
+}
+
+/**
+ * Move a file to the front of the list (adding it if it isn't there).
+ * @param file  the file
+ */
+void FileManager::used(HeapFile *file) {
+    lock_guard<recursive_mutex> lock(this->latch);
+    if (!this->lru.empty() && this->lru.front() == file)
+        return;
+    map<HeapFile *, FileList::iterator>::iterator found = this->positions.find(file);
+    if (found != this->positions.end())
+        this->lru.splice(this->lru.begin(), this->lru, found->second);
+    else
+        this->lru.push_front(file);
+    this->positions[file] = this->lru.begin();
+}
+
+/**
+ * Take a file off the list.
+ * @param file  the file
+ */
+void FileManager::closed(HeapFile *file) {
+    lock_guard<recursive_mutex> lock(this->latch);
+    map<HeapFile *, FileList::iterator>::iterator found = this->positions.find(file);
+    if (found == this->positions.end())
+        return;
+    this->lru.erase(found->second);
+    this->positions.erase(found);
+}
+
+/**
+ * Change the limit.
+ * @param max_open  most files to have open at a time
+ */
+void FileManager::set_max_open(uint max_open) {
+    lock_guard<recursive_mutex> lock(this->latch);
+    this->max_open = max_open;
+    evict(nullptr);
+}
+
+/**
+ * Get the number of files open right now.
+ * @return open file count
+ */
+uint FileManager::get_open_count() const {
+    lock_guard<recursive_mutex> lock(this->latch);
+    return (uint) this->lru.size();
+}
+
+/**
+ * Close the least recently used files that aren't in use until we are within the limit
+ * (or there are no more we can close).
+ * @param keep  a file not to close, or nullptr
+ */
+void FileManager::evict(HeapFile *keep) {
+    // pick them all first, since closing a file takes it off the list
+    vector<HeapFile *> victims;
+    uint open = (uint) this->lru.size();
+    for (FileList::reverse_iterator it = this->lru.rbegin(); open > this->max_open && it != this->lru.rend(); it++) {
+        if (*it == keep || (*it)->in_use())
+            continue;
+        victims.push_back(*it);
+        open--;
+    }
+    for (auto const &file: victims)
+        file->close();
+}
@@ -0,0 +1,96 @@
+/**
+ * @file FileManager.h - Limit on how many heap files are open at once.
+ * FileManager
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include "storage_engine.h"
+
+class HeapFile;  // forward declare
+
+/**
+ * @class FileManager - keeps track of the open HeapFiles and closes the least recently used
+ *
+ * Each open heap file holds Berkeley DB handles (and file descriptors) for itself and its
+ * side files. HeapFile::create and open report here, and once more than max_open files are
+ * open the least recently used ones are closed. A closed file reopens itself the next time
+ * it is used, so this is invisible to the tables on top. A file that has blocks pinned in the
+ * buffer pool (or otherwise says it is in use) is passed over. The list is latched so files
+ * can be used from several threads.
+ */
+class FileManager {
+public:
+    /**
+     * Default number of heap files that may be open at a time
+     */
+    static const uint DEFAULT_MAX_OPEN = 256;
+
+    /**
+     * The process-wide manager that HeapFile uses.
+     * @returns  the manager
+     */
+    static FileManager &get_manager();
+
+    FileManager(uint max_open = DEFAULT_MAX_OPEN);
+
+    virtual ~FileManager() {}
+
+    FileManager(const FileManager &other) = delete;
+
+    FileManager(FileManager &&temp) = delete;
+
+    FileManager &operator=(const FileManager &other) = delete;
+
+    FileManager &operator=(FileManager &&temp) = delete;
+
+    /**
+     * Note that a file has just been opened, closing others if that makes too many.
+     * @param file  the file
+     */
+    virtual void opened(HeapFile *file);
+
+    /**
+     * Note that an open file is being used, making it the most recently used.
+     * @param file  the file
+     */
+    virtual void used(HeapFile *file);
+
+    /**
+     * Forget a file that has been closed (or destroyed).
+     * @param file  the file
+     */
+    virtual void closed(HeapFile *file);
+
+    /**
+     * Change the limit, closing files now if there are too many open.
+     * @param max_open  most files to have open at a time
+     */
+    virtual void set_max_open(uint max_open);
+
+    /**
+     * Get the limit.
+     * @returns  most files to have open at a time
+     */
+    virtual uint get_max_open() const { return max_open; }
+
+    /**
+     * Get the number of files open right now.
+     * @returns  open file count
+     */
+    virtual uint get_open_count() const;
+
+protected:
+    typedef std::list<HeapFile *> FileList;
+
+    FileList lru;  // open files, most recently used first
+    std::map<HeapFile *, FileList::iterator> positions;
+    uint max_open;
+    mutable std::recursive_mutex latch;  // recursive since closing a file calls closed()
+
+    virtual void evict(HeapFile *keep);
+};
@@ -0,0 +1,197 @@
+/**
+ * @file FreeSpaceMap.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "FreeSpaceMap.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name  name of the heap file this map is for
+ */
+FreeSpaceMap::FreeSpaceMap(string name) : dbfilename(name + ".fsm.db"), closed(true), db(nullptr),
+                                          pool(BufferPool::get_pool()), step(DbBlock::BLOCK_SZ / 256), page_max() {
+}
+
+/**
+ * Destructor - make sure the buffer pool doesn't hold on to any of our pages.
+ */
+FreeSpaceMap::~FreeSpaceMap() {
+    if (!this->closed)
+        this->pool.flush(this);
+    this->pool.discard(this);
+    db_close();
+}
+
+/**
+ * Create the physical map file (initially empty).
+ */
+void FreeSpaceMap::create(void) {
+    db_open(DB_CREATE | DB_EXCL);
+}
+
+/**
+ * Remove the physical map file.
+ */
+void FreeSpaceMap::drop(void) {
+    this->pool.discard(this);
+    close();
+    Db db(_DB_ENV, 0);
+    db.remove(this->dbfilename.c_str(), nullptr, 0);
+}
+
+/**
+ * Open the physical map file.
+ * @throws DbException if it doesn't exist
+ */
+void FreeSpaceMap::open(void) {
+    db_open();
+}
+
+/**
+ * Write back our dirty pages, leaving the file open.
+ */
+void FreeSpaceMap::flush(void) {
+    if (!this->closed)
+        this->pool.flush(this);
+}
+
+/**
+ * Write back our dirty pages and close the physical map file.
+ */
+void FreeSpaceMap::close(void) {
+    if (this->closed)
+        return;
+    this->pool.flush(this);
+    this->pool.discard(this);
+    db_close();
+    this->closed = true;
+}
+
+/**
+ * Record the room left in a heap block.
+ * @param block_id    heap block
+ * @param free_bytes  how big a new record could be and still fit
+ * @return            change in the recorded room, in bytes (a multiple of step)
+ */
+int FreeSpaceMap::set(BlockID block_id, uint free_bytes) {
+    uint8_t category = (uint8_t) min(free_bytes / this->step, 255U);
+    uint page = block_id / ENTRIES_PER_PAGE;
+    BufferFrame *frame = pin_page(page);
+    uint8_t *entry = (uint8_t *) frame->data + block_id % ENTRIES_PER_PAGE;
+    int change = ((int) category - (int) *entry) * (int) this->step;
+    if (*entry != category) {
+        *entry = category;
+        this->pool.mark_dirty(frame);
+    }
+    this->pool.unpin(frame);
+    if (category > this->page_max[page])
+        this->page_max[page] = category;  // if it went down, find() will lower page_max lazily
+    return change;
+}
+
+/**
+ * Look for the first heap block known to have room for the given size.
+ * @param size  size of the new record
+ * @return      block id, or 0 if none
+ */
+BlockID FreeSpaceMap::find(uint size) {
+    uint needed = max((size + this->step - 1) / this->step, 1U);
+    if (needed > 255)
+        return 0;
+    for (uint page = 0; page < this->page_max.size(); page++) {
+        if (this->page_max[page] < needed)
+            continue;
+        BufferFrame *frame = pin_page(page);
+        uint8_t *entries = (uint8_t *) frame->data;
+        uint8_t largest = 0;
+        for (uint i = 0; i < ENTRIES_PER_PAGE; i++) {
+            if (entries[i] >= needed) {
+                this->pool.unpin(frame);
+                return page * ENTRIES_PER_PAGE + i;
+            }
+            largest = max(largest, entries[i]);
+        }
+        this->pool.unpin(frame);
+        this->page_max[page] = largest;  // now we know better
+    }
+    return 0;
+}
+
+/**
+ * Pin the given map page, adding it (zeroed) if the map doesn't reach that far yet.
+ * @param page  0-based map page number
+ * @return      pinned frame holding the page (caller unpins)
+ */
+BufferFrame *FreeSpaceMap::pin_page(uint page) {
+    if (page < this->page_max.size())
+        return this->pool.pin(this, page + 1);  // RecNo numbers from 1
+    BufferFrame *frame = nullptr;
+    while (this->page_max.size() <= page) {
+        if (frame != nullptr)
+            this->pool.unpin(frame);
+        frame = this->pool.pin(this, (BlockID) this->page_max.size() + 1, true);
+        memset(frame->data, 0, DbBlock::BLOCK_SZ);
+        this->pool.mark_dirty(frame);
+        this->page_max.push_back(0);
+    }
+    return frame;
+}
+
+/**
+ * Read a map page from Berkeley DB into the given memory.
+ * @param block_id  which page (1-based)
+ * @param data      where to put it
+ */
+void FreeSpaceMap::read_block(BlockID block_id, void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt(data, DbBlock::BLOCK_SZ);
+    dbt.set_ulen(DbBlock::BLOCK_SZ);
+    dbt.set_flags(DB_DBT_USERMEM);
+    this->db->get(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Write a map page to Berkeley DB.
+ * @param block_id  which page (1-based)
+ * @param data      the page's bytes
+ */
+void FreeSpaceMap::write_block(BlockID block_id, const void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt((void *) data, DbBlock::BLOCK_SZ);
+    this->db->put(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Wrapper for Berkeley DB open, which does both open and creation. A new map has no pages;
+ * an existing one has the number given to set_page_count.
+ * @param flags BerkDb flags
+ */
+void FreeSpaceMap::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    this->db = new Db(_DB_ENV, 0);
+    this->db->set_re_len(DbBlock::BLOCK_SZ);
+    try {
+        this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+    } catch (DbException &e) {
+        db_close();
+        throw;
+    }
+    this->closed = false;
+    if (flags)
+        this->page_max.clear();
+}
+
+/**
+ * Close and let go of the Berkeley DB handle, if we have one.
+ */
+void FreeSpaceMap::db_close() {
+    if (this->db == nullptr)
+        return;
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file FreeSpaceMap.h - Persistent record of how much room each block of a HeapFile has.
+ * FreeSpaceMap: BufferedFile
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <vector>
+#include "db_cxx.h"
+#include "BufferPool.h"
+
+/**
+ * @class FreeSpaceMap - coarse free-space bookkeeping for the blocks of one HeapFile
+ *
+ * Keeps one byte per heap block giving its free space in units of 1/256 of a heap block (rounded down,
+ * so the map never overstates the room in a block). The bytes are packed into map pages of
+ * DbBlock::BLOCK_SZ entries each, stored in their own Berkeley DB RecNo file next to the heap
+ * file and cached in the BufferPool like any other block. We also keep the largest entry of
+ * each map page in memory so a search only has to look inside pages that can satisfy it.
+ * Those start out unknown (as big as possible) when the map is opened and are lowered as
+ * searches look inside the pages, so opening the map doesn't read it. The number of map pages
+ * is kept in the heap file's header (see set_page_count), so neither does it count them.
+ */
+class FreeSpaceMap : public BufferedFile {
+public:
+    /**
+     * Number of map entries (heap blocks) covered by one map page
+     */
+    static const uint ENTRIES_PER_PAGE = DbBlock::BLOCK_SZ;
+
+    FreeSpaceMap(std::string name);
+
+    virtual ~FreeSpaceMap();
+
+    FreeSpaceMap(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap(FreeSpaceMap &&temp) = delete;
+
+    FreeSpaceMap &operator=(const FreeSpaceMap &other) = delete;
+
+    FreeSpaceMap &operator=(FreeSpaceMap &&temp) = delete;
+
+    virtual void create(void);
+
+    virtual void drop(void);
+
+    virtual void open(void);
+
+    virtual void close(void);
+
+    virtual void flush(void);
+
+    /**
+     * Tell the map how big the heap file's blocks are (before any set or find).
+     * @param heap_block_size  bytes per heap block
+     */
+    virtual void set_heap_block_size(uint heap_block_size) { this->step = heap_block_size / 256; }
+
+    /**
+     * Tell the map how many pages it has (kept in the heap file's header), before open.
+     * @param num_pages  number of map pages
+     */
+    virtual void set_page_count(uint num_pages) { this->page_max.assign(num_pages, 255); }
+
+    /**
+     * Number of map pages, for the heap file's header.
+     * @returns  page count
+     */
+    virtual uint get_page_count() const { return (uint) page_max.size(); }
+
+    /**
+     * Record how much room a heap block has.
+     * @param block_id    heap block
+     * @param free_bytes  how big a new record could be and still fit in the block (see SlottedPage::free_space)
+     * @returns           change in the room the map records for the block, in bytes
+     */
+    virtual int set(BlockID block_id, uint free_bytes);
+
+    /**
+     * Find a heap block that the map says has room for a record of the given size.
+     * @param size  size of the new record
+     * @returns     block id, or 0 if the map doesn't know of one
+     */
+    virtual BlockID find(uint size);
+
+protected:
+    std::string dbfilename;
+    bool closed;
+    Db *db;  // opened in db_open
+    BufferPool &pool;
+    uint step;  // bytes of free space represented by one unit of a map entry
+    std::vector<uint8_t> page_max;  // per map page: no entry is larger than this
+
+    virtual void read_block(BlockID block_id, void *data);
+
+    virtual void write_block(BlockID block_id, const void *data);
+
+    virtual void db_open(uint flags = 0);
+
+    virtual void db_close();
+
+    virtual BufferFrame *pin_page(uint page);
+};
@@ -0,0 +1,645 @@
+/**
+ * @file HashIndex.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include <cstring>
+#include "HashIndex.h"
+#include "HeapTable.h"
+
+using namespace std;
+
+static const uint ENTRY_SIZE = sizeof(uint32_t) + sizeof(BlockID) + sizeof(RecordID);
+
+/**
+ * What the stat record at the start of the file holds (followed by the directory block ids)
+ */
+struct HashStat {
+    uint32_t level;
+    uint32_t split;
+    uint32_t free_head;
+    uint32_t directory_blocks;
+    uint64_t count;
+};
+
+/**
+ * Constructor
+ * @param relation     the table being indexed
+ * @param name         name of the index
+ * @param key_columns  columns of the search key, in order
+ * @param unique       whether no two rows may have the same key
+ */
+HashIndex::HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique)
+        : DbIndex(relation, name, key_columns, unique), file(nullptr), closed(true),
+          key_profile(get_key_profile()), stat_id(0), level(0), split(0), free_head(0), count(0), directory(),
+          buckets() {
+    this->file = new HeapFile(relation.get_table_name() + "-" + name);
+}
+
+HashIndex::~HashIndex() {
+    close();
+    delete this->file;
+}
+
+/**
+ * Create the index file with INITIAL_BUCKETS empty buckets, then index the rows already in
+ * the table.
+ */
+void HashIndex::create() {
+    this->file->create();
+    this->closed = false;
+    this->stat_id = this->file->next_block_id(0);  // the page create() makes
+    this->level = this->split = this->free_head = 0;
+    this->count = 0;
+    this->directory.clear();
+    this->buckets.clear();
+    for (uint i = 0; i < INITIAL_BUCKETS; i++)
+        add_bucket();
+    write_stat();
+    Handles *handles = nullptr;
+    try {
+        handles = this->relation.select();
+        insert_batch(handles);
+    } catch (...) {
+        delete handles;
+        drop();
+        throw;
+    }
+    delete handles;
+}
+
+/**
+ * Remove the index file.
+ */
+void HashIndex::drop() {
+    this->file->drop();
+    this->closed = true;
+}
+
+/**
+ * Open the index file and read in the bucket directory.
+ */
+void HashIndex::open() {
+    if (!this->closed)
+        return;
+    this->file->open();
+    this->stat_id = this->file->next_block_id(0);
+    read_stat();
+    this->closed = false;
+}
+
+/**
+ * Close the index file.
+ */
+void HashIndex::close() {
+    if (this->closed)
+        return;
+    this->file->close();
+    this->closed = true;
+}
+
+/**
+ * Write back the index's changed blocks, e.g., at the end of a statement.
+ */
+void HashIndex::flush() {
+    if (!this->closed)
+        this->file->flush();
+}
+
+/**
+ * Find the rows with the given key: read the one bucket the key hashes to, and check the key
+ * of each row there with the same hash.
+ * @param key_values  a value for each of the key columns
+ * @return            handles of the rows (freed by caller)
+ */
+Handles *HashIndex::lookup(ValueDict *key_values) const {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    uint32_t key_hash = hash(key_values);
+    Handles *handles = new Handles();
+    try {
+        BlockID block_id = this->buckets[bucket_for(key_hash)];
+        while (block_id != 0) {
+            Entries entries;
+            read_block(block_id, entries, block_id);
+            for (auto const &entry: entries) {
+                if (entry.hash != key_hash)
+                    continue;
+                ValueDict *row = this->relation.project(entry.handle, &this->key_columns);
+                bool match = true;
+                for (uint i = 0; match && i < this->key_columns.size(); i++) {
+                    const Value &a = row->at(this->key_columns[i]), &b = key_values->at(this->key_columns[i]);
+                    match = this->key_profile[i] == ColumnAttribute::TEXT ? a.s == b.s : a.n == b.n;
+                }
+                delete row;
+                if (match)
+                    handles->push_back(entry.handle);
+            }
+        }
+    } catch (...) {
+        delete handles;
+        throw;
+    }
+    return handles;
+}
+
+/**
+ * Add the entry for a row to the first block of its bucket's chain with room (adding an
+ * overflow block if none has), then split a bucket if the index has gotten too full.
+ * @param record  handle of the row (must be in the relation)
+ * @throws        DbRelationError if the index is unique and the row's key is already there
+ */
+void HashIndex::insert(Handle record) {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    ValueDict *row = this->relation.project(record, &this->key_columns);
+    Entry entry;
+    try {
+        entry.hash = hash(row);
+        entry.handle = record;
+        if (this->unique) {
+            Handles *handles = lookup(row);
+            bool duplicate = !handles->empty();
+            delete handles;
+            if (duplicate)
+                throw DbRelationError("duplicate key in unique index " + this->name);
+        }
+    } catch (...) {
+        delete row;
+        throw;
+    }
+    delete row;
+
+    BlockID block_id = this->buckets[bucket_for(entry.hash)];
+    while (true) {
+        Entries entries;
+        BlockID next;
+        read_block(block_id, entries, next);
+        if (entries.size() < entries_per_block()) {
+            entries.push_back(entry);
+            write_block(block_id, entries, next);
+            break;
+        }
+        if (next == 0) {
+            BlockID overflow = new_block();
+            write_block(overflow, Entries(1, entry), 0);
+            write_block(block_id, entries, overflow);
+            break;
+        }
+        block_id = next;
+    }
+    this->count++;
+    if (this->count * 100 > (uint64_t) LOAD_FACTOR * entries_per_block() * this->buckets.size())
+        split_bucket();
+    write_stat();
+}
+
+/**
+ * Add the entries for several rows. Each entry's bucket is worked out up front, the entries
+ * are sorted by bucket, and each bucket's chain is filled in one pass (with overflow blocks
+ * added as needed). Then buckets are split until the index is within its load factor again.
+ * A unique index adds them one at a time instead, so each key is checked against the rest.
+ * @param records  handles of the rows (must be in the relation)
+ */
+void HashIndex::insert_batch(const Handles *records) {
+    if (this->unique) {
+        DbIndex::insert_batch(records);
+        return;
+    }
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    vector<pair<uint, Entry>> placed;
+    placed.reserve(records->size());
+    for (auto const &record: *records) {
+        ValueDict *row = this->relation.project(record, &this->key_columns);
+        Entry entry;
+        try {
+            entry.hash = hash(row);
+        } catch (...) {
+            delete row;
+            throw;
+        }
+        delete row;
+        entry.handle = record;
+        placed.push_back(pair<uint, Entry>(bucket_for(entry.hash), entry));
+    }
+    stable_sort(placed.begin(), placed.end(),
+                [](const pair<uint, Entry> &a, const pair<uint, Entry> &b) { return a.first < b.first; });
+
+    uint per_block = entries_per_block();
+    uint i = 0;
+    while (i < placed.size()) {
+        BlockID block_id = this->buckets[placed[i].first];
+        uint end = i;
+        while (end < placed.size() && placed[end].first == placed[i].first)
+            end++;
+        while (i < end) {
+            Entries entries;
+            BlockID next;
+            read_block(block_id, entries, next);
+            uint added = min(end - i, per_block - min(per_block, (uint) entries.size()));
+            for (uint k = 0; k < added; k++)
+                entries.push_back(placed[i++].second);
+            bool extended = i < end && next == 0;
+            if (extended) {
+                next = new_block();
+                write_block(next, Entries(), 0);
+            }
+            if (added > 0 || extended)
+                write_block(block_id, entries, next);
+            block_id = next;
+        }
+    }
+    this->count += placed.size();
+    while (this->count * 100 > (uint64_t) LOAD_FACTOR * per_block * this->buckets.size())
+        split_bucket();
+    write_stat();
+}
+
+/**
+ * Remove the entry for a row.
+ * @param record  handle of the row (must still be in the relation)
+ */
+void HashIndex::del(Handle record) {
+    if (this->closed)
+        throw DbRelationError("index " + this->name + " is not open");
+    ValueDict *row = this->relation.project(record, &this->key_columns);
+    uint32_t key_hash;
+    try {
+        key_hash = hash(row);
+    } catch (...) {
+        delete row;
+        throw;
+    }
+    delete row;
+    BlockID block_id = this->buckets[bucket_for(key_hash)];
+    while (block_id != 0) {
+        Entries entries;
+        BlockID next;
+        read_block(block_id, entries, next);
+        for (uint i = 0; i < entries.size(); i++) {
+            if (entries[i].handle == record) {
+                entries.erase(entries.begin() + i);
+                write_block(block_id, entries, next);
+                this->count--;
+                write_stat();
+                return;
+            }
+        }
+        block_id = next;
+    }
+}
+
+/**
+ * Hash the key values (FNV-1a over the values as they would be stored).
+ * @param key_values  a value for each of the key columns
+ * @return            32-bit hash
+ * @throws            DbRelationError if a key column is missing
+ */
+uint32_t HashIndex::hash(const ValueDict *key_values) const {
+    uint32_t h = 2166136261U;
+    for (uint i = 0; i < this->key_columns.size(); i++) {
+        ValueDict::const_iterator found = key_values->find(this->key_columns[i]);
+        if (found == key_values->end())
+            throw DbRelationError("lookup in index " + this->name + " needs a value for every key column");
+        const Value &value = found->second;
+        string bytes;
+        if (this->key_profile[i] == ColumnAttribute::TEXT) {
+            uint32_t size = (uint32_t) value.s.size();
+            bytes.append((const char *) &size, sizeof(size));
+            bytes.append(value.s);
+        } else if (this->key_profile[i] == ColumnAttribute::BOOLEAN) {
+            bytes.push_back(value.n != 0 ? 1 : 0);
+        } else {
+            bytes.append((const char *) &value.n, sizeof(int32_t));
+        }
+        for (auto const &byte: bytes) {
+            h ^= (uint8_t) byte;
+            h *= 16777619U;
+        }
+    }
+    return h;
+}
+
+/**
+ * Which bucket a hash goes in. Buckets before the split pointer have already been split, so
+ * they use one more bit of the hash.
+ * @param hash  hash of a key
+ * @return      bucket number
+ */
+uint HashIndex::bucket_for(uint32_t hash) const {
+    uint32_t n = INITIAL_BUCKETS << this->level;
+    uint32_t bucket = hash % n;
+    if (bucket < this->split)
+        bucket = hash % (2 * n);
+    return bucket;
+}
+
+/**
+ * Most entries a bucket block can hold.
+ * @return entry count
+ */
+uint HashIndex::entries_per_block() const {
+    return (this->file->get_block_size() - 16 - sizeof(BlockID)) / ENTRY_SIZE;
+}
+
+/**
+ * Most bucket ids a directory block can hold.
+ * @return bucket count
+ */
+uint HashIndex::buckets_per_directory_block() const {
+    return (this->file->get_block_size() - 16) / sizeof(BlockID);
+}
+
+/**
+ * Read the entries of one block of a bucket.
+ * @param block_id  the block
+ * @param entries   appended to
+ * @param next      set to the next block in the chain, or 0
+ */
+void HashIndex::read_block(BlockID block_id, Entries &entries, BlockID &next) const {
+    SlottedPage *page = this->file->get(block_id);
+    RecordView record = page->view(1);
+    if (record.data == nullptr) {
+        delete page;
+        throw DbRelationError("index block " + to_string(block_id) + " is not a bucket");
+    }
+    memcpy(&next, record.data, sizeof(BlockID));
+    for (uint offset = sizeof(BlockID); offset + ENTRY_SIZE <= record.size; offset += ENTRY_SIZE) {
+        Entry entry;
+        memcpy(&entry.hash, record.data + offset, sizeof(uint32_t));
+        memcpy(&entry.handle.first, record.data + offset + sizeof(uint32_t), sizeof(BlockID));
+        memcpy(&entry.handle.second, record.data + offset + sizeof(uint32_t) + sizeof(BlockID), sizeof(RecordID));
+        entries.push_back(entry);
+    }
+    delete page;
+}
+
+/**
+ * Write one block of a bucket.
+ * @param block_id  the block
+ * @param entries   its entries (no more than entries_per_block)
+ * @param next      next block in the chain, or 0
+ */
+void HashIndex::write_block(BlockID block_id, const Entries &entries, BlockID next) {
+    string bytes;
+    bytes.reserve(sizeof(BlockID) + entries.size() * ENTRY_SIZE);
+    bytes.append((const char *) &next, sizeof(BlockID));
+    for (auto const &entry: entries) {
+        bytes.append((const char *) &entry.hash, sizeof(uint32_t));
+        bytes.append((const char *) &entry.handle.first, sizeof(BlockID));
+        bytes.append((const char *) &entry.handle.second, sizeof(RecordID));
+    }
+    put_record(block_id, bytes);
+}
+
+/**
+ * Rewrite a bucket's chain with the given entries, packed into as few blocks as they need.
+ * Blocks left over go on the free list; more are taken if the chain is too short.
+ * @param chain    the chain's blocks, primary first (updated to what the chain ends up as)
+ * @param entries  the entries for the bucket
+ */
+void HashIndex::write_chain(vector<BlockID> &chain, const Entries &entries) {
+    uint per_block = entries_per_block();
+    uint needed = entries.empty() ? 1 : (uint) ((entries.size() + per_block - 1) / per_block);
+    while (chain.size() < needed)
+        chain.push_back(new_block());
+    while (chain.size() > needed) {
+        write_block(chain.back(), Entries(), this->free_head);
+        this->free_head = chain.back();
+        chain.pop_back();
+    }
+    for (uint i = 0; i < needed; i++) {
+        Entries::const_iterator begin = entries.begin() + min((size_t) i * per_block, entries.size());
+        Entries::const_iterator end = entries.begin() + min((size_t) (i + 1) * per_block, entries.size());
+        write_block(chain[i], Entries(begin, end), i + 1 < needed ? chain[i + 1] : 0);
+    }
+}
+
+/**
+ * Write a block's one record, replacing what was there.
+ * @param block_id  the block
+ * @param bytes     the record
+ */
+void HashIndex::put_record(BlockID block_id, const string &bytes) {
+    Dbt data((void *) bytes.data(), (u_int32_t) bytes.size());
+    SlottedPage *page = this->file->get(block_id);
+    try {
+        if (page->next_id(0) == 0)
+            page->add(&data);
+        else
+            page->put(1, data);
+        this->file->put(page);
+    } catch (...) {
+        delete page;
+        throw;
+    }
+    delete page;
+}
+
+/**
+ * Get a block for a bucket, from the free list if there is one there.
+ * @return block id
+ */
+BlockID HashIndex::new_block() {
+    if (this->free_head != 0) {
+        BlockID block_id = this->free_head;
+        Entries entries;
+        read_block(block_id, entries, this->free_head);
+        return block_id;
+    }
+    SlottedPage *page = this->file->get_new();
+    BlockID block_id = page->get_block_id();
+    delete page;
+    return block_id;
+}
+
+/**
+ * Add an empty bucket at the end of the table.
+ */
+void HashIndex::add_bucket() {
+    BlockID block_id = new_block();
+    write_block(block_id, Entries(), 0);
+    this->buckets.push_back(block_id);
+    write_directory((uint) this->buckets.size() - 1);
+}
+
+/**
+ * Split the bucket at the split pointer: add a bucket at the end, and move the entries that
+ * hash there with one more bit over to it.
+ */
+void HashIndex::split_bucket() {
+    uint32_t n = INITIAL_BUCKETS << this->level;
+    uint32_t bucket = this->split;
+    vector<BlockID> chain;
+    Entries entries, staying, moving;
+    for (BlockID block_id = this->buckets[bucket]; block_id != 0;) {
+        chain.push_back(block_id);
+        read_block(block_id, entries, block_id);
+    }
+    for (auto const &entry: entries)
+        (entry.hash % (2 * n) == bucket ? staying : moving).push_back(entry);
+    add_bucket();
+    write_chain(chain, staying);
+    vector<BlockID> new_chain(1, this->buckets.back());
+    write_chain(new_chain, moving);
+    if (++this->split == n) {
+        this->split = 0;
+        this->level++;
+    }
+}
+
+/**
+ * Read the stat record and the directory blocks it lists.
+ */
+void HashIndex::read_stat() {
+    SlottedPage *page = this->file->get(this->stat_id);
+    RecordView record = page->view(1);
+    HashStat stat;
+    bool ok = record.data != nullptr && record.size >= sizeof(HashStat);
+    if (ok) {
+        memcpy(&stat, record.data, sizeof(HashStat));
+        ok = record.size == sizeof(HashStat) + stat.directory_blocks * sizeof(BlockID);
+    }
+    if (ok) {
+        this->directory.resize(stat.directory_blocks);
+        memcpy(this->directory.data(), record.data + sizeof(HashStat), stat.directory_blocks * sizeof(BlockID));
+    }
+    delete page;
+    if (!ok)
+        throw DbRelationError("index " + this->name + " has no directory");
+    this->level = stat.level;
+    this->split = stat.split;
+    this->free_head = stat.free_head;
+    this->count = stat.count;
+
+    this->buckets.clear();
+    for (auto const &block_id: this->directory) {
+        page = this->file->get(block_id);
+        record = page->view(1);
+        uint start = (uint) this->buckets.size();
+        this->buckets.resize(start + record.size / sizeof(BlockID));
+        memcpy(this->buckets.data() + start, record.data, record.size);
+        delete page;
+    }
+    if (this->buckets.size() != (INITIAL_BUCKETS << this->level) + this->split)
+        throw DbRelationError("index " + this->name + " directory is the wrong size");
+}
+
+/**
+ * Write the stat record.
+ */
+void HashIndex::write_stat() {
+    HashStat stat;
+    stat.level = this->level;
+    stat.split = this->split;
+    stat.free_head = this->free_head;
+    stat.directory_blocks = (uint32_t) this->directory.size();
+    stat.count = this->count;
+    string bytes((const char *) &stat, sizeof(HashStat));
+    bytes.append((const char *) this->directory.data(), this->directory.size() * sizeof(BlockID));
+    put_record(this->stat_id, bytes);
+}
+
+/**
+ * Write the directory block that a bucket's id is in, adding a directory block if it is the
+ * first bucket of a new one.
+ * @param bucket  bucket number
+ * @throws        DbRelationError if the stat record can't list another directory block
+ */
+void HashIndex::write_directory(uint bucket) {
+    uint per_block = buckets_per_directory_block();
+    uint d = bucket / per_block;
+    if (d == this->directory.size()) {
+        if (sizeof(HashStat) + (d + 1) * sizeof(BlockID) > this->file->get_block_size() - 16)
+            throw DbRelationError("index " + this->name + " has too many buckets");
+        this->directory.push_back(new_block());
+    }
+    uint end = min((uint) this->buckets.size(), (d + 1) * per_block);
+    string bytes((const char *) (this->buckets.data() + d * per_block), (end - d * per_block) * sizeof(BlockID));
+    put_record(this->directory[d], bytes);
+}
+
+
+// test function -- returns true if all tests pass
+bool test_hash_index() {
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+    HeapTable table("_test_hash_index_cpp", column_names, column_attributes);
+    table.create();
+
+    ValueDict row;
+    Handles inserted;
+    for (int i = 0; i < 3000; i++) {
+        row["a"] = Value(i);
+        row["b"] = Value("session " + to_string(i % 3));
+        inserted.push_back(table.insert(&row));
+    }
+    ColumnNames key_a;
+    key_a.push_back("a");
+    HashIndex index(table, "hxa", key_a, true);
+    index.create();
+    if (index.get_bucket_count() <= HashIndex::INITIAL_BUCKETS)
+        return assertion_failure("buckets did not split", index.get_bucket_count());
+    ValueDict key;
+    for (int i = 0; i < 3000; i += 7) {
+        key["a"] = Value(i);
+        Handles *handles = index.lookup(&key);
+        bool ok = handles->size() == 1 && (*handles)[0] == inserted[i];
+        delete handles;
+        if (!ok)
+            return assertion_failure("lookup", i);
+    }
+    key["a"] = Value(3000);
+    Handles *handles = index.lookup(&key);
+    if (!handles->empty())
+        return assertion_failure("lookup of missing key", (double) handles->size());
+    delete handles;
+    row["a"] = Value(1234);
+    Handle duplicate = table.insert(&row);
+    try {
+        index.insert(duplicate);
+        return assertion_failure("duplicate key not caught");
+    } catch (DbRelationError &e) {
+        table.del(duplicate);
+    }
+    cout << "hash index lookup ok" << endl;
+
+    // only three distinct keys, so their buckets need overflow chains
+    ColumnNames key_b;
+    key_b.push_back("b");
+    HashIndex sessions(table, "hxb", key_b, false);
+    sessions.create();
+    for (int i = 0; i < 3000; i += 2) {
+        index.del(inserted[i]);
+        sessions.del(inserted[i]);
+        table.del(inserted[i]);
+    }
+    key.clear();
+    key["b"] = Value("session 1");
+    handles = sessions.lookup(&key);
+    bool ok = handles->size() == 500;
+    delete handles;
+    sessions.close();
+    HashIndex reopened(table, "hxb", key_b, false);
+    reopened.open();
+    handles = reopened.lookup(&key);
+    ok = ok && handles->size() == 500 && reopened.get_bucket_count() == sessions.get_bucket_count();
+    delete handles;
+    key["b"] = Value("session 4");
+    handles = reopened.lookup(&key);
+    ok = ok && handles->empty();
+    delete handles;
+    if (!ok)
+        return assertion_failure("overflow/del/reopen");
+    cout << "hash index overflow/del/reopen ok" << endl;
+
+    index.drop();
+    reopened.drop();
+    table.drop();
+    return true;
+}
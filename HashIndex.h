@@ -0,0 +1,139 @@
+/**
+ * @file HashIndex.h - Implementation of DbIndex with linear hashing.
+ * HashIndex: DbIndex
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "HeapFile.h"
+
+/**
+ * @class HashIndex - linear hashing index (implementation of DbIndex)
+ *
+ * The index is kept in a HeapFile of its own named <table>-<index>. Each bucket is a chain of
+ * blocks: a primary block and any overflow blocks linked from it. A bucket block holds one
+ * record: the id of the next block in the chain, then the entries, each the 32-bit hash of a
+ * row's key and the row's handle. Only the hash is kept, so entries are a fixed size and a
+ * split never has to look at the rows; lookup checks the key of each row whose hash matches.
+ *
+ * The table of buckets grows one bucket at a time. When the entries average more than
+ * LOAD_FACTOR of a block per bucket, the bucket at the split pointer is divided between itself
+ * and a new bucket at the end, and the pointer moves on; when it has gone all the way around,
+ * the number of buckets has doubled and the level goes up. So a lookup reads one bucket, of
+ * about one block, however big the table gets.
+ *
+ * The first block of the file holds the level, split pointer, entry count, free list of
+ * overflow blocks, and the ids of the directory blocks. These map bucket numbers to their
+ * primary blocks. Overflow blocks a split empties go on the free list for reuse. Deletes
+ * leave empty overflow blocks in their chain.
+ *
+ * The index must be created or opened before it is used.
+ */
+class HashIndex : public DbIndex {
+public:
+    /**
+     * Number of buckets in a new index
+     */
+    static const uint INITIAL_BUCKETS = 4;
+
+    /**
+     * How full, in percent of a block, the buckets may be on average before one is split
+     */
+    static const uint LOAD_FACTOR = 75;
+
+    HashIndex(DbRelation &relation, Identifier name, ColumnNames key_columns, bool unique);
+
+    virtual ~HashIndex();
+
+    HashIndex(const HashIndex &other) = delete;
+
+    HashIndex(HashIndex &&temp) = delete;
+
+    HashIndex &operator=(const HashIndex &other) = delete;
+
+    HashIndex &operator=(HashIndex &&temp) = delete;
+
+    virtual void create();
+
+    virtual void drop();
+
+    virtual void open();
+
+    virtual void close();
+
+    virtual void flush();
+
+    virtual Handles *lookup(ValueDict *key_values) const;
+
+    virtual void insert(Handle record);
+
+    /**
+     * Insert the entries for several records, grouped by bucket so that each block of a
+     * bucket is read and written once.
+     * @param records  handles of the records (must be in the relation)
+     */
+    virtual void insert_batch(const Handles *records);
+
+    virtual void del(Handle record);
+
+    /**
+     * Number of buckets right now.
+     * @returns  bucket count
+     */
+    virtual uint get_bucket_count() const { return (uint) buckets.size(); }
+
+protected:
+    /**
+     * One entry in a bucket block
+     */
+    struct Entry {
+        uint32_t hash;
+        Handle handle;
+    };
+
+    typedef std::vector<Entry> Entries;
+
+    HeapFile *file;
+    bool closed;
+    KeyProfile key_profile;
+    BlockID stat_id;                   // block holding the stat record
+    uint32_t level;                    // buckets are INITIAL_BUCKETS * 2^level plus split
+    uint32_t split;                    // next bucket to split
+    uint32_t free_head;                // first overflow block free for reuse, or 0
+    uint64_t count;                    // number of entries
+    std::vector<BlockID> directory;    // blocks holding the primary block ids of the buckets
+    std::vector<BlockID> buckets;      // primary block id of each bucket
+
+    virtual uint32_t hash(const ValueDict *key_values) const;
+
+    virtual uint bucket_for(uint32_t hash) const;
+
+    virtual uint entries_per_block() const;
+
+    virtual uint buckets_per_directory_block() const;
+
+    virtual void read_block(BlockID block_id, Entries &entries, BlockID &next) const;
+
+    virtual void write_block(BlockID block_id, const Entries &entries, BlockID next);
+
+    virtual void write_chain(std::vector<BlockID> &chain, const Entries &entries);
+
+    virtual void put_record(BlockID block_id, const std::string &bytes);
+
+    virtual BlockID new_block();
+
+    virtual void add_bucket();
+
+    virtual void split_bucket();
+
+    virtual void read_stat();
+
+    virtual void write_stat();
+
+    virtual void write_directory(uint bucket);
+};
+
+bool test_hash_index();
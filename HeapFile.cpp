@@ -13,42 +13,105 @@ typedef uint16_t u16;
 /**
  * Constructor
  * @param name
+ * @param block_size  bytes per block if the file gets created (an existing file keeps its own)
+ * @throws std::invalid_argument if block_size isn't 4, 8, 16 or 32kB
  */
-HeapFile::HeapFile(string name) : DbFile(name), dbfilename(""), last(0), closed(true), db(_DB_ENV, 0) {
+HeapFile::HeapFile(string name, uint block_size) : DbFile(name), dbfilename(""), first_block(2), last(0),
+                                                   row_count(0), free_bytes(0), schema_version(0),
+                                                   block_size(block_size), read_ahead(DEFAULT_READ_AHEAD), closed(true),
+                                                   db(nullptr), pool(BufferPool::get_pool()),
+                                                   files(FileManager::get_manager()), fsm(name), overflow(name) {
+    if (!DbBlock::valid_block_size(block_size))
+        throw invalid_argument("unsupported block size " + to_string(block_size));
     this->dbfilename = this->name + ".db";
 }
 
 /**
- * Create physical file.
+ * Destructor - make sure the buffer pool doesn't hold on to any of our blocks.
+ */
+HeapFile::~HeapFile() {
+    if (!this->closed) {
+        write_header();
+        this->pool.flush(this);
+    }
+    this->pool.discard(this);
+    db_close();
+    this->files.closed(this);
+}
+
+/**
+ * Create physical file, with its header and one empty block.
  */
 void HeapFile::create(void) {
     db_open(DB_CREATE | DB_EXCL);
+    this->fsm.create();
+    this->overflow.create();
+    this->last = this->first_block - 1;
+    this->row_count = 0;
+    this->free_bytes = 0;
+    this->schema_version = 0;
+    write_header();
+    this->pool.flush(this);  // so the header is the first record
     SlottedPage *page = get_new(); // force one page to exist
     delete page;
+    this->files.opened(this);
 }
 
 /**
  * Delete the physical file.
  */
 void HeapFile::drop(void) {
-    close();
+    this->pool.discard(this);  // no point writing back blocks (or the header) we are about to remove
+    if (!this->closed) {
+        db_close();
+        this->closed = true;
+    }
+    this->files.closed(this);
     Db db(_DB_ENV, 0);
     db.remove(this->dbfilename.c_str(), nullptr, 0);
+    this->fsm.drop();
+    this->overflow.drop();
 }
 
 /**
- * Open physical file.
+ * Open physical file. Called again whenever the file is used, so that one the FileManager has
+ * closed reopens and one that is open counts as recently used.
  */
 void HeapFile::open(void) {
+    if (!this->closed) {
+        this->files.used(this);
+        return;
+    }
     db_open();
+    this->files.opened(this);
 }
 
 /**
  * Close the physical file.
  */
 void HeapFile::close(void) {
-    this->db.close(0);
-    this->closed = true;
+    if (!this->closed) {
+        write_header();
+        this->pool.flush(this);
+        this->pool.discard(this);
+        db_close();
+        this->closed = true;
+    }
+    this->fsm.close();
+    this->overflow.close();
+    this->files.closed(this);
+}
+
+/**
+ * Write back our dirty blocks and those of the free-space map and overflow file.
+ */
+void HeapFile::flush(void) {
+    if (this->closed)
+        return;
+    write_header();
+    this->pool.flush(this);
+    this->fsm.flush();
+    this->overflow.flush();
 }
 
 /**
@@ -56,41 +119,77 @@ void HeapFile::close(void) {
  * @return the new empty DbBlock that is managing the records in this block and its block id.
  */
 SlottedPage *HeapFile::get_new(void) {
-    char block[DbBlock::BLOCK_SZ];
-    memset(block, 0, sizeof(block));
-    Dbt data(block, sizeof(block));
-
-    int block_id = ++this->last;
-    Dbt key(&block_id, sizeof(block_id));
+    open();
+    BlockID block_id = ++this->last;  // atomic, so threads adding blocks at once each get their own
+    BufferFrame *frame = this->pool.pin(this, block_id, true);
+    memset(frame->data, 0, this->block_size);
+    Dbt data(frame->data, this->block_size);
+    SlottedPage *page = new SlottedPage(data, block_id, true, frame);
 
-    // write out an empty block and read it back in so Berkeley DB is managing the memory
-    SlottedPage *page = new SlottedPage(data, this->last, true);
-    this->db.put(nullptr, &key, &data, 0); // write it out with initialization done to it
-    delete page;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, this->last);
+    // write out the initialized block right away so Berkeley DB knows about it
+    write_block(block_id, frame->data);
+    lock_guard<mutex> lock(this->space_latch);
+    this->free_bytes += this->fsm.set(block_id, page->free_space());
+    write_header();
+    return page;
 }
 
 /**
  * Get a block from the database file.
  * @param block_id
- * @return          the given slotted page (freed by caller)
+ * @return          the given slotted page, pinned in the buffer pool until it is freed (freed by caller)
  */
 SlottedPage *HeapFile::get(BlockID block_id) {
-    Dbt key(&block_id, sizeof(block_id));
-    Dbt data;
-    this->db.get(nullptr, &key, &data, 0);
-    return new SlottedPage(data, block_id, false);
+    open();
+    BufferFrame *frame = this->pool.pin(this, block_id);
+    Dbt data(frame->data, this->block_size);
+    return new SlottedPage(data, block_id, false, frame);
 }
 
 /**
- * Write a block back to the database file.
+ * Write a block back to the database file. The write goes to the block's buffer frame, which
+ * is marked dirty and written to disk later.
  * @param block
  */
 void HeapFile::put(DbBlock *block) {
-    int block_id = block->get_block_id();
-    Dbt key(&block_id, sizeof(block_id));
-    this->db.put(nullptr, &key, block->get_block(), 0);
+    open();
+    SlottedPage *page = (SlottedPage *) block;
+    {
+        lock_guard<mutex> lock(this->space_latch);
+        this->free_bytes += this->fsm.set(block->get_block_id(), page->free_space());
+    }
+    BufferFrame *frame = page->get_frame();
+    if (frame != nullptr && frame->file == this && frame->block_id == block->get_block_id()) {
+        this->pool.mark_dirty(frame);
+        return;
+    }
+    // not one of our pool pages, so copy it into a frame
+    frame = this->pool.pin(this, block->get_block_id(), true);
+    memcpy(frame->data, block->get_data(), this->block_size);
+    this->pool.mark_dirty(frame);
+    this->pool.unpin(frame);
+}
+
+/**
+ * Mark the frame of a block we handed out dirty.
+ * @param block  the block
+ */
+void HeapFile::mark_dirty(DbBlock *block) {
+    BufferFrame *frame = ((SlottedPage *) block)->get_frame();
+    if (frame != nullptr && frame->file == this && frame->block_id == block->get_block_id())
+        this->pool.mark_dirty(frame);
+}
+
+/**
+ * Ask the free-space map for a block that can take a record of the given size.
+ * @param size  size of the record's data
+ * @return      block id, or 0 if the map knows of none
+ */
+BlockID HeapFile::find_free_block(uint size) {
+    open();
+    lock_guard<mutex> lock(this->space_latch);
+    BlockID block_id = this->fsm.find(size);
+    return block_id <= this->last ? block_id : 0;
 }
 
 /**
@@ -99,33 +198,210 @@ void HeapFile::put(DbBlock *block) {
  */
 BlockIDs *HeapFile::block_ids() const {
     BlockIDs *vec = new BlockIDs();
-    for (BlockID block_id = 1; block_id <= this->last; block_id++)
+    for (BlockID block_id = this->first_block; block_id <= this->last; block_id++)
         vec->push_back(block_id);
     return vec;
 }
 
 /**
- * Ask BerkDb how many blocks we are currently using in the file.
- * @return number of blocks
+ * Next block id after the given one. Blocks are numbered first_block through last.
+ * @param block_id  previous block id, or 0 to start at the beginning
+ * @return          following block id, or 0 if there are no more
+ */
+BlockID HeapFile::next_block_id(BlockID block_id) const {
+    if (block_id == 0)
+        return this->first_block <= this->last ? this->first_block : 0;
+    return block_id < this->last ? block_id + 1 : 0;
+}
+
+/**
+ * Bring a run of blocks into the buffer pool with one batched read.
+ * @param first  first block id of the run
+ * @param count  number of blocks in it (cut short at the end of the file)
+ */
+void HeapFile::prefetch(BlockID first, uint count) {
+    open();
+    BlockIDs block_ids;
+    for (BlockID block_id = max(first, this->first_block); block_id <= this->last && block_ids.size() < count;
+         block_id++)
+        block_ids.push_back(block_id);
+    if (block_ids.size() > 1)
+        this->pool.prefetch(this, block_ids);
+}
+
+/**
+ * Check whether any of our blocks are pinned (so closing us now would pull them out from under
+ * whoever has them).
+ * @return true if so
+ */
+bool HeapFile::in_use() const {
+    return this->pool.has_pinned((BufferedFile *) this);
+}
+
+/**
+ * The header as it should be written.
+ * @return our header fields
+ */
+HeapFile::Header HeapFile::get_header() const {
+    Header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MAGIC;
+    header.block_size = this->block_size;
+    header.last = this->last;
+    header.schema_version = this->schema_version;
+    header.row_count = this->row_count;
+    header.free_bytes = this->free_bytes;
+    header.fsm_pages = this->fsm.get_page_count();
+    this->overflow.get_pages(header.overflow_last, header.overflow_free);
+    return header;
+}
+
+/**
+ * Take our fields from a header that has been read in.
+ * @param header  the header
+ */
+void HeapFile::set_header(const Header &header) {
+    this->last = header.last;
+    this->schema_version = header.schema_version;
+    this->row_count = header.row_count;
+    this->free_bytes = header.free_bytes;
+    this->fsm.set_page_count(header.fsm_pages);
+    this->overflow.set_pages(header.overflow_last, header.overflow_free);
+}
+
+/**
+ * Read the header page (record 1) through the buffer pool.
+ * @throws DbRelationError if the file doesn't start with one
+ */
+void HeapFile::read_header() {
+    Header header;
+    BufferFrame *frame = this->pool.pin(this, 1);
+    memcpy(&header, frame->data, sizeof(header));
+    this->pool.unpin(frame);
+    if (header.magic != MAGIC || header.last < this->first_block - 1 || header.overflow_last == 0)
+        throw DbRelationError(this->dbfilename + " has no header page (made by an older version?)");
+    set_header(header);
+}
+
+/**
+ * Update the header page in the buffer pool; it is written out along with our blocks.
+ */
+void HeapFile::write_header() {
+    Header header = get_header();
+    BufferFrame *frame = this->pool.pin(this, 1, true);  // no need to read what we overwrite
+    memset(frame->data, 0, this->block_size);
+    memcpy(frame->data, &header, sizeof(header));
+    this->pool.mark_dirty(frame);
+    this->pool.unpin(frame);
+}
+
+/**
+ * Read a block from Berkeley DB straight into the given memory (a buffer frame).
+ * @param block_id  which block to read
+ * @param data      where to put it (must have room for block_size bytes)
  */
-uint32_t HeapFile::get_block_count() {
-    DB_BTREE_STAT *stat;
-    this->db.stat(nullptr, &stat, DB_FAST_STAT);
-    uint32_t bt_ndata = stat->bt_ndata;
-    free(stat);
-    return bt_ndata;
+void HeapFile::read_block(BlockID block_id, void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt(data, this->block_size);
+    dbt.set_ulen(this->block_size);
+    dbt.set_flags(DB_DBT_USERMEM);
+    this->db->get(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Write a block from the given memory (a buffer frame) to Berkeley DB.
+ * @param block_id  which block to write
+ * @param data      the block's bytes
+ */
+void HeapFile::write_block(BlockID block_id, const void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt((void *) data, this->block_size);
+    this->db->put(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Read several blocks. A run of consecutive ones is read with a single cursor walk, which
+ * follows the file's pages in order rather than searching for each key from the root.
+ * @param block_ids  which blocks
+ * @param data       where to put each of them
+ */
+void HeapFile::read_blocks(const BlockIDs &block_ids, const vector<char *> &data) {
+    if (block_ids.empty())
+        return;
+    Dbc *cursor;
+    this->db->cursor(nullptr, &cursor, 0);
+    try {
+        db_recno_t recno = block_ids[0];
+        Dbt key(&recno, sizeof(recno));
+        key.set_ulen(sizeof(recno));
+        key.set_flags(DB_DBT_USERMEM);
+        for (uint i = 0; i < block_ids.size(); i++) {
+            Dbt dbt(data[i], this->block_size);
+            dbt.set_ulen(this->block_size);
+            dbt.set_flags(DB_DBT_USERMEM);
+            if (i > 0 && block_ids[i] == recno + 1) {
+                if (cursor->get(&key, &dbt, DB_NEXT) == 0 && recno == block_ids[i])
+                    continue;
+            }
+            recno = block_ids[i];  // first one, or not the next after the last: look it up
+            cursor->get(&key, &dbt, DB_SET);
+        }
+    } catch (...) {
+        cursor->close();
+        throw;
+    }
+    cursor->close();
 }
 
 /**
  * Wrapper for Berkeley DB open, which does both open and creation.
+ * Opening an existing file reads its header page rather than asking Berkeley DB to count
+ * the records.
  * @param flags BerkDb flags
  */
 void HeapFile::db_open(uint flags) {
     if (!this->closed)
         return;
-    this->db.set_re_len(DbBlock::BLOCK_SZ); // record length - will be ignored if file already exists
-    this->db.open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags, 0644);
+    this->db = new Db(_DB_ENV, 0);  // a closed handle can't be opened again
+    this->db->set_re_len(this->block_size); // record length - will be ignored if file already exists
+    try {
+        this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+    } catch (DbException &e) {
+        db_close();
+        throw;
+    }
+    u_int32_t re_len;
+    this->db->get_re_len(&re_len);
+    if (!DbBlock::valid_block_size(re_len)) {
+        db_close();
+        throw invalid_argument("unsupported block size " + to_string(re_len) + " in " + this->dbfilename);
+    }
+    this->block_size = re_len;
+    this->fsm.set_heap_block_size(re_len);
+    this->overflow.set_block_size(re_len);
 
-    this->last = flags ? 0 : get_block_count();
     this->closed = false;
+    if (!flags) {
+        try {
+            read_header();
+        } catch (DbRelationError &e) {
+            this->pool.discard(this);
+            db_close();
+            this->closed = true;
+            throw;
+        }
+        this->fsm.open();
+        this->overflow.open();
+    }
+}
+
+/**
+ * Close and let go of the Berkeley DB handle, if we have one.
+ */
+void HeapFile::db_close() {
+    if (this->db == nullptr)
+        return;
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
 }
@@ -7,8 +7,14 @@
  */
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include "db_cxx.h"
 #include "SlottedPage.h"
+#include "BufferPool.h"
+#include "FreeSpaceMap.h"
+#include "OverflowFile.h"
+#include "FileManager.h"
 
 
 /**
@@ -16,14 +22,54 @@
  *
  * Heap file organization. Built on top of Berkeley DB RecNo file. There is one of our
         database blocks for each Berkeley DB record in the RecNo file. In this way we are using Berkeley DB
-        for buffer management and file management.
+        for file management. Buffer management is done by our own BufferPool: get, put, and get_new
+        work on pinned frames and dirty blocks are written back on eviction or close.
         Uses SlottedPage for storing records within blocks.
+        A FreeSpaceMap alongside the file tracks the room left in each block; put and get_new keep
+        it current and find_free_block consults it so inserts can reuse space freed by deletes.
+        Values too big to keep in a block are stored out of line in an OverflowFile alongside.
+        Block size is chosen when the file is created (4, 8, 16 or 32kB) and kept as the RecNo
+        record length, so an existing file is always opened with the size it was made with.
+        Scans read ahead: each prefetch walks the next window of records with one Berkeley DB
+        cursor instead of looking each block up by key.
+        The first record of the file is a header page (see Header) rather than a block, so the
+        blocks are numbered from 2. The header also holds the sizes of the free-space map and
+        overflow file, so opening a file just reads the header, however big the file is.
+        Open files are counted by the FileManager, which may close this one when too many are
+        open; the methods that need the file open it again if so.
+        get_new, put, find_free_block and add_rows may be called from several threads at once:
+        new block ids come from an atomic counter, and the free-space map is latched.
  */
-class HeapFile : public DbFile {
+class HeapFile : public DbFile, public BufferedFile {
 public:
-    HeapFile(std::string name);
+    /**
+     * Default number of blocks a scan reads ahead (see prefetch)
+     */
+    static const uint DEFAULT_READ_AHEAD = 32;
+
+    /**
+     * Identifies the header page of one of our files
+     */
+    static const uint32_t MAGIC = 0x48454150;
 
-    virtual ~HeapFile() {}
+    /**
+     * What the header page of a file holds about it (at the start of the page; the rest is 0)
+     */
+    struct Header {
+        uint32_t magic;           // MAGIC, or that of the subclass that made the file
+        uint32_t block_size;
+        uint32_t last;            // id of the final block
+        uint32_t schema_version;  // for the relation on top, see set_schema_version
+        uint64_t row_count;       // number of records in all the blocks
+        uint64_t free_bytes;      // total room in the blocks, as recorded in the free-space map
+        uint32_t fsm_pages;       // pages in the free-space map
+        uint32_t overflow_last;   // id of the overflow file's final page (at least 1)
+        uint32_t overflow_free;   // first page of the overflow file's free list (0 for none)
+    };
+
+    HeapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ);
+
+    virtual ~HeapFile();
 
     HeapFile(const HeapFile &other) = delete;
 
@@ -41,28 +87,146 @@ public:
 
     virtual void close(void);
 
+    /**
+     * Write back all our dirty blocks (and those of the side files), leaving the file open.
+     */
+    virtual void flush(void);
+
     virtual SlottedPage *get_new(void);
 
     virtual SlottedPage *get(BlockID block_id);
 
     virtual void put(DbBlock *block);
 
+    /**
+     * Note that a block the caller is still working on has changed, so it gets written back
+     * even if the pool flushes it before the caller puts it. Cheaper than put, which also
+     * updates the free-space map.
+     * @param block  a block gotten from this file
+     */
+    virtual void mark_dirty(DbBlock *block);
+
     virtual BlockIDs *block_ids() const;
 
+    virtual BlockID next_block_id(BlockID block_id) const;
+
+    /**
+     * Hint that a scan is about to read a run of blocks in order, so they can be fetched
+     * into the buffer pool together.
+     * @param first  first block id of the run
+     * @param count  number of blocks in it
+     */
+    virtual void prefetch(BlockID first, uint count);
+
+    /**
+     * Set how far ahead scans of this file read (0 turns read-ahead off).
+     * @param blocks  read-ahead window in blocks
+     */
+    virtual void set_read_ahead(uint blocks) { read_ahead = blocks; }
+
+    /**
+     * How far ahead scans of this file read.
+     * @return read-ahead window in blocks
+     */
+    virtual uint get_read_ahead() const { return read_ahead; }
+
     /**
      * Get the id of the current final block in the heap file.
      * @return block id of last block
      */
     virtual uint32_t get_last_block_id() { return last; }
 
+    /**
+     * Get the number of records in the file.
+     * @return row count (kept up to date by the relation through add_rows)
+     */
+    virtual uint64_t get_row_count() const { return row_count; }
+
+    /**
+     * Adjust the row count as records are added or deleted.
+     * @param delta  number of records added (negative for deleted)
+     */
+    virtual void add_rows(int delta) { row_count += delta; }
+
+    /**
+     * Get the total room left in the file's blocks.
+     * @return free bytes, as recorded in the free-space map (so slightly understated)
+     */
+    virtual uint64_t get_free_bytes() const { return free_bytes; }
+
+    /**
+     * Get the version number the relation on top gave its schema.
+     * @return schema version (0 until one is set)
+     */
+    virtual uint32_t get_schema_version() const { return schema_version; }
+
+    /**
+     * Record a version number for the relation's schema (kept in the header).
+     * @param version  new schema version
+     */
+    virtual void set_schema_version(uint32_t version) { schema_version = version; }
+
+    /**
+     * Find a block with room for a new record of the given size.
+     * @param size  size of the record's data
+     * @return      id of a block believed to have room, or 0 if none is known
+     */
+    virtual BlockID find_free_block(uint size);
+
+    /**
+     * Size of this file's blocks (known once the file is open or created).
+     * @return bytes per block
+     */
+    virtual uint get_block_size() const { return block_size; }
+
+    /**
+     * Access the storage for this file's out-of-line values.
+     * @return the overflow file (open whenever this file is)
+     */
+    virtual OverflowFile &get_overflow() {
+        open();
+        return overflow;
+    }
+
+    /**
+     * Check whether the file can't be closed right now because blocks of it are in use.
+     * @return true if any of our blocks are pinned in the buffer pool
+     */
+    virtual bool in_use() const;
+
 protected:
     std::string dbfilename;
-    uint32_t last;
+    BlockID first_block;  // blocks are numbered first_block through last
+    std::atomic<uint32_t> last;
+    std::atomic<uint64_t> row_count;
+    uint64_t free_bytes;
+    uint32_t schema_version;
+    uint block_size;
+    uint read_ahead;
     bool closed;
-    Db db;
+    Db *db;  // a new handle each time we open (Berkeley DB handles can't be reopened)
+    BufferPool &pool;
+    FileManager &files;
+    FreeSpaceMap fsm;
+    OverflowFile overflow;
+    std::mutex space_latch;  // guards fsm, free_bytes and the header while blocks are added and put
 
     virtual void db_open(uint flags = 0);
 
-    virtual uint32_t get_block_count();
+    virtual void db_close();
+
+    virtual void read_block(BlockID block_id, void *data);
+
+    virtual void write_block(BlockID block_id, const void *data);
+
+    virtual void read_blocks(const BlockIDs &block_ids, const std::vector<char *> &data);
+
+    virtual Header get_header() const;
+
+    virtual void set_header(const Header &header);
+
+    virtual void read_header();
+
+    virtual void write_header();
 };
 
@@ -3,7 +3,14 @@
  * @author K Lundeen
  * @see Seattle University, CPSC5300
  */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "HeapTable.h"
 
 using namespace std;
@@ -14,9 +21,27 @@ typedef uint16_t u16;
  * @param table_name
  * @param column_names
  * @param column_attributes
+ * @param block_size         bytes per block if the table's file gets created (4, 8, 16 or 32kB)
+ * @param engine             kind of file to keep the table's blocks in
  */
-HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes) : DbRelation(
-        table_name, column_names, column_attributes), file(table_name) {
+HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+                     uint block_size, Engine engine) : DbRelation(table_name, column_names, column_attributes),
+                                                       file(nullptr), insert_pages(), insert_latch(), indices(),
+                                                       index_latch() {
+    if (engine == MMAP)
+        this->file = new MmapFile(table_name, block_size);
+    else if (engine == ASYNC_IO)
+        this->file = new AsyncFile(table_name, block_size);
+    else
+        this->file = new HeapFile(table_name, block_size);
+}
+
+/**
+ * Destructor
+ */
+HeapTable::~HeapTable() {
+    release_insert_pages();
+    delete this->file;
 }
 
 /**
@@ -24,7 +49,7 @@ HeapTable::HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttr
  * Is not responsible for metadata storage or validation.
  */
 void HeapTable::create() {
-    file.create();
+    file->create();
 }
 
 /**
@@ -43,21 +68,31 @@ void HeapTable::create_if_not_exists() {
  * Execute: DROP TABLE <table_name>
  */
 void HeapTable::drop() {
-    file.drop();
+    release_insert_pages();
+    file->drop();
 }
 
 /**
  * Open existing table. Enables: insert, update, delete, select, project
  */
 void HeapTable::open() {
-    file.open();
+    file->open();
 }
 
 /**
  * Closes the table. Disables: insert, update, delete, select, project
  */
 void HeapTable::close() {
-    file.close();
+    release_insert_pages();
+    file->close();
+}
+
+/**
+ * Put back the insertion page and write back all the table's changes (a commit boundary).
+ */
+void HeapTable::flush() {
+    release_insert_pages();
+    file->flush();
 }
 
 /**
@@ -67,12 +102,62 @@ void HeapTable::close() {
  */
 Handle HeapTable::insert(const ValueDict *row) {
     open();
-    ValueDict *full_row = validate(row);
-    Handle handle = append(full_row);
+    Row *full_row = validate(row);
+    Handle handle;
+    try {
+        handle = append(full_row);
+    } catch (...) {
+        delete full_row;
+        throw;
+    }
     delete full_row;
+    if (!this->indices.empty()) {
+        try {
+            index_rows(Handles(1, handle));
+        } catch (...) {
+            erase(Handles(1, handle));
+            throw;
+        }
+    }
     return handle;
 }
 
+/**
+ * Execute: INSERT INTO <table_name> (<row_keys>) VALUES (<row_values>), ... for many rows at once.
+ * Rows are marshalled into one reusable buffer and packed into the insertion page. If a row
+ * fails (or an index refuses the rows), the rows already placed are taken back out, so either
+ * all of them go in or none do.
+ * @param rows dictionaries with column name keys
+ * @return handles of the inserted rows, in order (freed by caller)
+ */
+Handles *HeapTable::insert_batch(const ValueDicts *rows) {
+    open();
+    Handles *handles = new Handles();
+    char bytes[DbBlock::MAX_BLOCK_SZ];
+    try {
+        for (auto const &row: *rows) {
+            Row *full_row = validate(row);
+            uint size;
+            try {
+                size = marshal(full_row, bytes);
+            } catch (...) {
+                delete full_row;
+                throw;
+            }
+            delete full_row;
+            Dbt data(bytes, size);
+            handles->push_back(place(&data));
+        }
+        if (!this->indices.empty())
+            index_rows(*handles);
+    } catch (...) {
+        erase(*handles);
+        delete handles;
+        throw;
+    }
+    return handles;
+}
+
 /**
  * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
  * where handle is sufficient to identify one specific record (e.g., returned from an insert
@@ -87,17 +172,107 @@ void HeapTable::update(const Handle handle, const ValueDict *new_values) {
 /**
  * Conceptually, execute: DELETE FROM <table_name> WHERE <handle>
  * where handle is sufficient to identify one specific record (e.g., returned from an insert
- * or select).
+ * or select). The row's index entries are removed first, while the row is still there for
+ * the indices to get its key from.
  * @param handle the row to be deleted
+ * @throws DbRelationError if there is no such row (then nothing is changed)
  */
 void HeapTable::del(const Handle handle) {
     open();
-    BlockID block_id = handle.first;
-    RecordID record_id = handle.second;
-    SlottedPage *block = this->file.get(block_id);
-    block->del(record_id);
-    this->file.put(block);
+    release_insert_pages();  // so none holds a stale copy of the block's header
+    SlottedPage *block = this->file->get(handle.first);
+    bool found = block->view(handle.second).data != nullptr;
     delete block;
+    if (!found)
+        throw DbRelationError("no such row");
+    if (!this->indices.empty()) {
+        lock_guard<mutex> lock(this->index_latch);
+        for (auto const &index: this->indices) {
+            index->open();
+            index->del(handle);
+        }
+    }
+    erase(Handles(1, handle));
+}
+
+/**
+ * Keep an index up to date from now on.
+ * @param index  an index on this table
+ */
+void HeapTable::add_index(DbIndex *index) {
+    lock_guard<mutex> lock(this->index_latch);
+    if (find(this->indices.begin(), this->indices.end(), index) == this->indices.end())
+        this->indices.push_back(index);
+}
+
+/**
+ * Stop keeping an index up to date.
+ * @param index  an index given to add_index
+ */
+void HeapTable::remove_index(DbIndex *index) {
+    lock_guard<mutex> lock(this->index_latch);
+    vector<DbIndex *>::iterator found = find(this->indices.begin(), this->indices.end(), index);
+    if (found != this->indices.end())
+        this->indices.erase(found);
+}
+
+/**
+ * Add newly inserted rows to every index, a batch at a time. If an index refuses them, take
+ * them back out of the indices they were given to, that one included (removing a row an index
+ * doesn't have is harmless), but not one that failed to open; taking them out of the table is
+ * up to the caller.
+ * @param handles  the new rows
+ */
+void HeapTable::index_rows(const Handles &handles) {
+    lock_guard<mutex> lock(this->index_latch);
+    uint done = 0;
+    bool reached = false;  // whether insert_batch was called on indices[done]
+    try {
+        for (; done < this->indices.size(); done++) {
+            reached = false;
+            this->indices[done]->open();
+            reached = true;
+            this->indices[done]->insert_batch(&handles);
+        }
+    } catch (...) {
+        for (uint i = 0; i < done + (reached ? 1 : 0); i++)
+            for (auto const &handle: handles)
+                this->indices[i]->del(handle);
+        throw;
+    }
+}
+
+/**
+ * Remove rows from the table's file (the indices are up to the caller). They are grouped by
+ * block, so each block is fetched and put back once. This may run while other threads
+ * insert, to take back rows the calling thread just inserted, so only the calling thread's
+ * insertion page is put back; the others are left to their threads.
+ * @param handles the rows to be deleted
+ */
+void HeapTable::erase(const Handles &handles) {
+    release_insert_page(own_insert_page());  // so it doesn't hold a stale copy of a block's header
+    Handles sorted(handles);
+    sort(sorted.begin(), sorted.end());
+    uint i = 0;
+    while (i < sorted.size()) {
+        BlockID block_id = sorted[i].first;
+        SlottedPage *block = this->file->get(block_id);
+        try {
+            for (; i < sorted.size() && sorted[i].first == block_id; i++) {
+                RecordView record = block->view(sorted[i].second);
+                if (record.data != nullptr) {
+                    free_out_of_line(record);
+                    this->file->add_rows(-1);
+                }
+                block->del(sorted[i].second);
+            }
+            this->file->put(block);
+        } catch (...) {
+            delete block;
+            throw;
+        }
+        delete block;
+    }
 }
 
 /**
@@ -114,22 +289,92 @@ Handles *HeapTable::select() {
  * @return list of handles of the selected rows
  */
 Handles *HeapTable::select(const ValueDict *where) {
-    open();
     Handles *handles = new Handles();
-    BlockIDs *block_ids = file.block_ids();
-    for (auto const &block_id: *block_ids) {
-        SlottedPage *block = file.get(block_id);
-        RecordIDs *record_ids = block->ids();
-        for (auto const &record_id: *record_ids) {
-            Handle handle(block_id, record_id);
-            if (selected(handle, where))
-                handles->push_back(Handle(block_id, record_id));
+    DbCursor *rows = cursor(where);
+    Handle handle;
+    while (rows->next(handle))
+        handles->push_back(handle);
+    delete rows;
+    return handles;
+}
+
+/**
+ * Start a lazy scan for the rows matching the where clause.
+ * @param where         predicates to match (need not outlive the cursor)
+ * @param column_names  columns to project as the cursor goes (nullptr or empty for all)
+ * @return cursor over the qualifying rows (freed by caller)
+ */
+DbCursor *HeapTable::cursor(const ValueDict *where, const ColumnNames *column_names) {
+    open();
+    return new HeapTableCursor(this, where, column_names);
+}
+
+/**
+ * Scan for the rows matching the where clause with several threads. The blocks are dealt out
+ * in runs of MORSEL_BLOCKS (morsels) to whichever worker is free next, and each worker filters
+ * and projects its morsels with its own cursor. The results are put back in block order.
+ * @param where         predicates to match (nullptr for all rows)
+ * @param column_names  columns to project (nullptr or empty for all)
+ * @param handles       if not nullptr, gets the handle of each row returned
+ * @param threads       workers to use, counting this thread (0 for one per core)
+ * @return              the projected rows, in table order (freed by caller, each row too)
+ */
+Rows *HeapTable::parallel_select(const ValueDict *where, const ColumnNames *column_names, Handles *handles,
+                                 uint threads) {
+    open();
+    Rows *result = new Rows();
+    BlockID first = this->file->next_block_id(0);
+    if (first == 0)
+        return result;
+    BlockID last = this->file->get_last_block_id();
+    uint morsels = (last - first) / MORSEL_BLOCKS + 1;
+    if (threads == 0)
+        threads = max(thread::hardware_concurrency(), 1U);
+    threads = min(threads, morsels);
+
+    vector<Rows> rows(morsels);
+    vector<Handles> row_handles(morsels);
+    atomic<uint> next_morsel(0);
+    exception_ptr failure;
+    mutex failure_latch;
+    auto work = [&]() {
+        try {
+            for (uint morsel = next_morsel++; morsel < morsels; morsel = next_morsel++) {
+                BlockID start = first + morsel * MORSEL_BLOCKS;
+                HeapTableCursor scan(this, where, column_names, start, min(start + MORSEL_BLOCKS - 1, last));
+                Handle handle;
+                Row *row;
+                while (scan.next(handle, row)) {
+                    rows[morsel].push_back(row);
+                    row_handles[morsel].push_back(handle);
+                }
+            }
+        } catch (...) {
+            lock_guard<mutex> lock(failure_latch);
+            if (!failure)
+                failure = current_exception();
+            next_morsel = morsels;  // the others stop after the morsel they are on
         }
-        delete record_ids;
-        delete block;
+    };
+    vector<thread> workers;
+    for (uint i = 1; i < threads; i++)
+        workers.push_back(thread(work));
+    work();
+    for (auto &worker: workers)
+        worker.join();
+
+    for (uint morsel = 0; morsel < morsels; morsel++) {
+        result->insert(result->end(), rows[morsel].begin(), rows[morsel].end());
+        if (handles != nullptr)
+            handles->insert(handles->end(), row_handles[morsel].begin(), row_handles[morsel].end());
     }
-    delete block_ids;
-    return handles;
+    if (failure) {
+        for (auto const &row: *result)
+            delete row;
+        delete result;
+        rethrow_exception(failure);
+    }
+    return result;
 }
 
 /**
@@ -148,41 +393,94 @@ ValueDict *HeapTable::project(Handle handle) {
  * @return a sequence of values for handle given by column_names
  */
 ValueDict *HeapTable::project(Handle handle, const ColumnNames *column_names) {
-    BlockID block_id = handle.first;
-    RecordID record_id = handle.second;
-    SlottedPage *block = file.get(block_id);
-    Dbt *data = block->get(record_id);
-    ValueDict *row = unmarshal(data);
-    delete data;
+    Row *row = project_row(handle, column_names);
+    ValueDict *result = row->to_dict();
+    delete row;
+    return result;
+}
+
+/**
+ * Project given columns from a given row, without going through a dictionary.
+ * @param handle        row to be projected
+ * @param column_names  columns to include (empty for all); the result refers to this list
+ * @return              the projected row (freed by caller)
+ */
+Row *HeapTable::project_row(Handle handle, const ColumnNames *column_names) {
+    ColumnOrdinals columns = ordinals(column_names);
+    SlottedPage *block = file->get(handle.first);
+    Row *row;
+    try {
+        RecordView record = block->view(handle.second);
+        if (record.data == nullptr)
+            throw DbRelationError("no such row");
+        if (column_names == nullptr || column_names->empty())
+            row = unmarshal(record);
+        else
+            row = unmarshal(record, column_names, columns);
+    } catch (...) {
+        delete block;
+        throw;
+    }
     delete block;
-    if (column_names->empty())
-        return row;
-    ValueDict *result = new ValueDict();
+    return row;
+}
+
+/**
+ * Find the position of each given column in this table.
+ * @param column_names  columns to look up (nullptr or empty for all of them)
+ * @return              ordinal of each column, in the same order
+ * @throws              DbRelationError if the table does not have one of them
+ */
+ColumnOrdinals HeapTable::ordinals(const ColumnNames *column_names) const {
+    ColumnOrdinals result;
+    if (column_names == nullptr || column_names->empty()) {
+        for (uint i = 0; i < this->column_names.size(); i++)
+            result.push_back(i);
+        return result;
+    }
     for (auto const &column_name: *column_names) {
-        if (row->find(column_name) == row->end())
+        uint i = 0;
+        while (i < this->column_names.size() && this->column_names[i] != column_name)
+            i++;
+        if (i == this->column_names.size())
             throw DbRelationError("table does not have column named '" + column_name + "'");
-        (*result)[column_name] = (*row)[column_name];
+        result.push_back(i);
+    }
+    return result;
+}
+
+/**
+ * Compile a where clause against this table's record layout.
+ * @param where  equality predicates keyed by column name (nullptr for none)
+ * @return       predicate to apply to marshalled records
+ * @throws       DbRelationError if the table does not have one of the columns
+ */
+RecordPredicate HeapTable::predicate(const ValueDict *where) {
+    RecordPredicate result(this->column_attributes, &this->file->get_overflow());
+    if (where == nullptr)
+        return result;
+    for (auto const &condition: *where) {
+        ColumnNames name(1, condition.first);
+        result.add(ordinals(&name)[0], RecordPredicate::EQ, condition.second);
     }
-    delete row;
     return result;
 }
 
 /**
  * Check if the given row is acceptable to insert.
  * @param row to be validated
- * @return the full row dictionary
+ * @return the full row, in column order (freed by caller)
  * @throws DbRelationError if not valid
  */
-ValueDict *HeapTable::validate(const ValueDict *row) const {
-    ValueDict *full_row = new ValueDict();
-    for (auto const &column_name: this->column_names) {
-        Value value;
-        ValueDict::const_iterator column = row->find(column_name);
-        if (column == row->end())
+Row *HeapTable::validate(const ValueDict *row) const {
+    Row *full_row = new Row(&this->column_names);
+    for (uint i = 0; i < this->column_names.size(); i++) {
+        ValueDict::const_iterator column = row->find(this->column_names[i]);
+        if (column == row->end()) {
+            delete full_row;
             throw DbRelationError("don't know how to handle NULLs, defaults, etc. yet");
-        else
-            value = column->second;
-        (*full_row)[column_name] = value;
+        }
+        (*full_row)[i] = column->second;
     }
     return full_row;
 }
@@ -192,23 +490,106 @@ ValueDict *HeapTable::validate(const ValueDict *row) const {
  * @param row to be appended
  * @return handle of newly inserted row
  */
-Handle HeapTable::append(const ValueDict *row) {
+Handle HeapTable::append(const Row *row) {
     Dbt *data = marshal(row);
-    SlottedPage *block = this->file.get(this->file.get_last_block_id());
-    RecordID record_id;
+    Handle handle;
     try {
-        record_id = block->add(data);
-    } catch (DbBlockNoRoomError &e) {
-        // need a new block
-        delete block;
-        block = this->file.get_new();
-        record_id = block->add(data);
+        handle = place(data);
+    } catch (...) {
+        delete[] (char *) data->get_data();
+        delete data;
+        throw;
     }
-    this->file.put(block);
-    delete block;
     delete[] (char *) data->get_data();
     delete data;
-    return Handle(this->file.get_last_block_id(), record_id);
+    return handle;
+}
+
+/**
+ * Add a marshalled record to this thread's insertion page. If it doesn't fit, the page is put
+ * back and the record goes into the block the free-space map suggests, or failing that a new
+ * block, which becomes the insertion page.
+ * @param data  the record
+ * @return      handle of the new record
+ */
+Handle HeapTable::place(const Dbt *data) {
+    SlottedPage *&page = own_insert_page();
+    for (int attempt = page == nullptr ? 1 : 0;; attempt++) {
+        if (page == nullptr) {
+            lock_guard<mutex> lock(this->insert_latch);
+            page = attempt == 1 ? block_for(data->get_size()) : this->file->get_new();
+        }
+        try {
+            RecordID record_id = page->add(data);
+            this->file->mark_dirty(page);
+            this->file->add_rows(1);
+            return Handle(page->get_block_id(), record_id);
+        } catch (DbBlockNoRoomError &e) {
+            release_insert_page(page);  // full, or the free-space map was out of date about it
+            if (attempt == 2)
+                throw;
+        }
+    }
+}
+
+/**
+ * Find the calling thread's insertion page.
+ * @return  the thread's slot for it (nullptr until it has one); the slot stays put until
+ *          release_insert_pages
+ */
+SlottedPage *&HeapTable::own_insert_page() {
+    lock_guard<mutex> lock(this->insert_latch);
+    return this->insert_pages[this_thread::get_id()];
+}
+
+/**
+ * Put back an insertion page (updating the free-space map) and unpin it.
+ * @param page  the page, set to nullptr
+ */
+void HeapTable::release_insert_page(SlottedPage *&page) {
+    if (page == nullptr)
+        return;
+    lock_guard<mutex> lock(this->insert_latch);
+    this->file->put(page);
+    delete page;
+    page = nullptr;
+}
+
+/**
+ * Put back every thread's insertion page.
+ */
+void HeapTable::release_insert_pages() {
+    for (auto &thread_page: this->insert_pages)
+        release_insert_page(thread_page.second);
+    this->insert_pages.clear();
+}
+
+/**
+ * Check whether a block is some thread's insertion page. Call with insert_latch held.
+ * @param block_id  the block
+ * @return          true if it is
+ */
+bool HeapTable::is_insert_page(BlockID block_id) const {
+    for (auto const &thread_page: this->insert_pages)
+        if (thread_page.second != nullptr && thread_page.second->get_block_id() == block_id)
+            return true;
+    return false;
+}
+
+/**
+ * Pick the block a new record should go into: one the free-space map says has room,
+ * else the last block in the file. If that is another thread's insertion page, a new block
+ * is added instead. Call with insert_latch held.
+ * @param size  size of the marshalled record
+ * @return      the block (freed by caller); it may still turn out not to have room
+ */
+SlottedPage *HeapTable::block_for(uint size) {
+    BlockID block_id = this->file->find_free_block(size);
+    if (block_id == 0)
+        block_id = this->file->get_last_block_id();
+    if (is_insert_page(block_id))
+        return this->file->get_new();
+    return this->file->get(block_id);
 }
 
 /**
@@ -217,95 +598,330 @@ Handle HeapTable::append(const ValueDict *row) {
  * @param row data for the tuple
  * @return bits of the record as it should appear on disk
  */
-Dbt *HeapTable::marshal(const ValueDict *row) const {
-    char *bytes = new char[DbBlock::BLOCK_SZ]; // more than we need (we insist that one row fits into DbBlock::BLOCK_SZ)
-    uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        ValueDict::const_iterator column = row->find(column_name);
-        Value value = column->second;
-
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            if (offset + 4 > DbBlock::BLOCK_SZ - 4)
-                throw DbRelationError("row too big to marshal");
-            *(int32_t *) (bytes + offset) = value.n;
-            offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u_long size = value.s.length();
-            if (size > UINT16_MAX)
+Dbt *HeapTable::marshal(const Row *row) {
+    char bytes[DbBlock::MAX_BLOCK_SZ]; // more than we need (we insist that one row fits into a block)
+    uint size = marshal(row, bytes);
+    char *right_size_bytes = new char[size];
+    memcpy(right_size_bytes, bytes, size);
+    Dbt *data = new Dbt(right_size_bytes, size);
+    return data;
+}
+
+/**
+ * Figure out the bits to go into the file, writing them into the caller's buffer.
+ * TEXT values bigger than a quarter of a block are written to the overflow file and only a
+ * pointer to them goes in the record (see OverflowFile). If the row still wouldn't fit in a
+ * block, so are the biggest of the other TEXT values, one at a time, until it does.
+ * @param row    data for the tuple, in column order
+ * @param bytes  where to put the bits (room for a block's worth)
+ * @return       size of the marshalled record
+ */
+uint HeapTable::marshal(const Row *row, char *bytes) {
+    uint block_size = this->file->get_block_size();
+    uint limit = block_size - 12;  // room in an empty block, after its header and the record's
+    uint num_columns = (uint) this->column_names.size();
+
+    // first work out which TEXT values go out of line
+    vector<bool> out_of_line(num_columns, false);
+    u_long total = 0;
+    for (uint col_num = 0; col_num < num_columns; col_num++) {
+        ColumnAttribute::DataType data_type = this->column_attributes[col_num].get_data_type();
+        if (data_type == ColumnAttribute::DataType::INT) {
+            total += sizeof(int32_t);
+        } else if (data_type == ColumnAttribute::DataType::TEXT) {
+            u_long size = (*row)[col_num].s.length();
+            if (size > UINT32_MAX)
                 throw DbRelationError("text field too long to marshal");
-            if (offset + 2 + size > DbBlock::BLOCK_SZ)
-                throw DbRelationError("row too big to marshal");
-            *(u16 *) (bytes + offset) = size;
-            offset += sizeof(u16);
-            memcpy(bytes + offset, value.s.c_str(), size); // assume ascii for now
-            offset += size;
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
-            if (offset + 1 > DbBlock::BLOCK_SZ - 1)
-                throw DbRelationError("row too big to marshal");
-            *(uint8_t *) (bytes + offset) = (uint8_t) value.n;
-            offset += sizeof(uint8_t);
+            out_of_line[col_num] = size > block_size / 4;
+            total += sizeof(u16) + (out_of_line[col_num] ? OverflowFile::POINTER_SZ : size);
+        } else if (data_type == ColumnAttribute::DataType::BOOLEAN) {
+            total += sizeof(uint8_t);
         } else {
             throw DbRelationError("Only know how to marshal INT, TEXT, and BOOLEAN");
         }
     }
-    char *right_size_bytes = new char[offset];
-    memcpy(right_size_bytes, bytes, offset);
-    delete[] bytes;
-    Dbt *data = new Dbt(right_size_bytes, offset);
-    return data;
+    while (total > limit) {
+        uint largest = num_columns;
+        u_long largest_size = OverflowFile::POINTER_SZ;  // moving out anything smaller doesn't help
+        for (uint col_num = 0; col_num < num_columns; col_num++) {
+            if (this->column_attributes[col_num].get_data_type() != ColumnAttribute::DataType::TEXT
+                || out_of_line[col_num])
+                continue;
+            u_long size = (*row)[col_num].s.length();
+            if (size > largest_size) {
+                largest = col_num;
+                largest_size = size;
+            }
+        }
+        if (largest == num_columns)
+            throw DbRelationError("row too big to marshal");
+        out_of_line[largest] = true;
+        total -= largest_size - OverflowFile::POINTER_SZ;
+    }
+
+    uint offset = 0;
+    BlockIDs chains;  // out-of-line values written so far, in case we have to give up
+    try {
+        for (uint col_num = 0; col_num < num_columns; col_num++) {
+            ColumnAttribute ca = this->column_attributes[col_num];
+            const Value &value = (*row)[col_num];
+
+            if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+                *(int32_t *) (bytes + offset) = value.n;
+                offset += sizeof(int32_t);
+            } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
+                u_long size = value.s.length();
+                if (out_of_line[col_num]) {
+                    BlockID first = this->file->get_overflow().write(value.s.data(), (uint32_t) size);
+                    chains.push_back(first);
+                    *(u16 *) (bytes + offset) = OverflowFile::TEXT_MARKER;
+                    *(uint32_t *) (bytes + offset + 2) = (uint32_t) size;
+                    *(uint32_t *) (bytes + offset + 2 + sizeof(uint32_t)) = first;
+                    offset += 2 + OverflowFile::POINTER_SZ;
+                    continue;
+                }
+                *(u16 *) (bytes + offset) = size;
+                offset += sizeof(u16);
+                memcpy(bytes + offset, value.s.c_str(), size); // assume ascii for now
+                offset += size;
+            } else {
+                *(uint8_t *) (bytes + offset) = (uint8_t) value.n;
+                offset += sizeof(uint8_t);
+            }
+        }
+    } catch (...) {
+        for (auto const &first: chains)
+            this->file->get_overflow().free(first);
+        throw;
+    }
+    return offset;
 }
 
 /**
  * Figure out the memory data structures from the given bits gotten from the file.
- * @param data file data for the tuple
+ * @param record file data for the tuple
  * @return row data for the tuple
  */
-ValueDict *HeapTable::unmarshal(Dbt *data) const {
-    ValueDict *row = new ValueDict();
-    Value value;
-    char *bytes = (char *) data->get_data();
+Row *HeapTable::unmarshal(const RecordView &record) {
+    Row *row = new Row(&this->column_names);
     uint offset = 0;
-    uint col_num = 0;
-    for (auto const &column_name: this->column_names) {
-        ColumnAttribute ca = this->column_attributes[col_num++];
-        value.data_type = ca.get_data_type();
-        if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
-            value.n = *(int32_t *) (bytes + offset);
-            offset += sizeof(int32_t);
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
-            u16 size = *(u16 *) (bytes + offset);
-            offset += sizeof(u16);
-            char buffer[DbBlock::BLOCK_SZ];
-            memcpy(buffer, bytes + offset, size);
-            buffer[size] = '\0';
-            value.s = string(buffer);  // assume ascii for now
-            offset += size;
-        } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
-            value.n = *(uint8_t *) (bytes + offset);
-            offset += sizeof(uint8_t);
-        } else {
-            throw DbRelationError("Only know how to unmarshal INT, TEXT, and BOOLEAN");
+    ValueView value;
+    string out_of_line;
+    try {
+        for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+            offset += unmarshal_value(record.data + offset, col_num, &value, &out_of_line);
+            (*row)[col_num] = value.to_value();
         }
-        (*row)[column_name] = value;
+    } catch (...) {
+        delete row;
+        throw;
     }
     return row;
 }
 
 /**
- * See if the row at the given handle satisfies the given where clause
- * @param handle  row to check
- * @param where   conditions to check
- * @return        true if conditions met, false otherwise
+ * Decode just the given columns from the bits gotten from the file.
+ * @param record        file data for the tuple
+ * @param column_names  names for the result (the result refers to this list)
+ * @param ordinals      position in the table of each of column_names
+ * @return              row of the requested values (freed by caller)
  */
-bool HeapTable::selected(Handle handle, const ValueDict *where) {
-    if (where == nullptr)
-        return true;
-    ValueDict *row = this->project(handle, where);
-    bool is_selected = *row == *where;
-    delete row;
-    return is_selected;
+Row *HeapTable::unmarshal(const RecordView &record, const ColumnNames *column_names, const ColumnOrdinals &ordinals) {
+    ValueViews values;
+    vector<string> out_of_line;
+    unmarshal(record, ordinals, values, out_of_line);
+    Row *row = new Row(column_names);
+    for (uint i = 0; i < values.size(); i++)
+        (*row)[i] = values[i].to_value();
+    return row;
+}
+
+/**
+ * Decode just the given columns from the bits gotten from the file, without copying any of
+ * them. Columns that are not asked for are stepped over (TEXT by its length prefix), and we
+ * stop after the last one that is. Out-of-line values are only fetched if they are asked for.
+ * @param record       file data for the tuple
+ * @param ordinals     position in the table of each column wanted
+ * @param values       set to views of the requested values, in the order of ordinals (they refer
+ *                     to the record's bytes, or to out_of_line)
+ * @param out_of_line  holds any out-of-line values that are fetched
+ */
+void HeapTable::unmarshal(const RecordView &record, const ColumnOrdinals &ordinals, ValueViews &values,
+                          vector<string> &out_of_line) {
+    values.resize(ordinals.size());
+    out_of_line.resize(ordinals.size());
+    uint end = 0;  // one past the last column we need
+    for (auto const &ordinal: ordinals)
+        end = max(end, ordinal + 1);
+    uint offset = 0;
+    for (uint col_num = 0; col_num < end; col_num++) {
+        uint first = 0;
+        while (first < ordinals.size() && ordinals[first] != col_num)
+            first++;
+        bool wanted = first < ordinals.size();
+        offset += unmarshal_value(record.data + offset, col_num, wanted ? &values[first] : nullptr,
+                                  wanted ? &out_of_line[first] : nullptr);
+        for (uint i = first + 1; wanted && i < ordinals.size(); i++)
+            if (ordinals[i] == col_num)
+                values[i] = values[first];  // same column asked for twice
+    }
+}
+
+/**
+ * Decode (or just measure) one marshalled column value.
+ * @param bytes        start of the column's bits
+ * @param col_num      which column of this table it is
+ * @param value        where to put a view of the value, or nullptr to skip it
+ * @param out_of_line  where to fetch the value to if it is stored out of line
+ * @return             number of bytes the column occupies
+ */
+uint HeapTable::unmarshal_value(const char *bytes, uint col_num, ValueView *value, string *out_of_line) {
+    ColumnAttribute ca = this->column_attributes[col_num];
+    if (value != nullptr)
+        value->data_type = ca.get_data_type();
+    if (ca.get_data_type() == ColumnAttribute::DataType::INT) {
+        if (value != nullptr)
+            value->n = *(int32_t *) bytes;
+        return sizeof(int32_t);
+    } else if (ca.get_data_type() == ColumnAttribute::DataType::TEXT) {
+        u16 size = *(u16 *) bytes;
+        if (size == OverflowFile::TEXT_MARKER) {
+            if (value != nullptr) {
+                uint32_t length = *(uint32_t *) (bytes + sizeof(u16));
+                BlockID first = *(uint32_t *) (bytes + sizeof(u16) + sizeof(uint32_t));
+                this->file->get_overflow().read(first, length, *out_of_line);
+                value->s = out_of_line->data();
+                value->s_size = length;
+            }
+            return sizeof(u16) + OverflowFile::POINTER_SZ;
+        }
+        if (value != nullptr) {
+            value->s = bytes + sizeof(u16);  // assume ascii for now
+            value->s_size = size;
+        }
+        return sizeof(u16) + size;
+    } else if (ca.get_data_type() == ColumnAttribute::DataType::BOOLEAN) {
+        if (value != nullptr)
+            value->n = *(uint8_t *) bytes;
+        return sizeof(uint8_t);
+    } else {
+        throw DbRelationError("Only know how to unmarshal INT, TEXT, and BOOLEAN");
+    }
+}
+
+/**
+ * Give back the overflow pages of any out-of-line values in a record that is going away.
+ * @param record  the record's bits
+ */
+void HeapTable::free_out_of_line(const RecordView &record) {
+    uint offset = 0;
+    for (uint col_num = 0; col_num < this->column_names.size(); col_num++) {
+        const char *bytes = record.data + offset;
+        if (this->column_attributes[col_num].get_data_type() == ColumnAttribute::DataType::TEXT
+            && *(u16 *) bytes == OverflowFile::TEXT_MARKER)
+            this->file->get_overflow().free(*(uint32_t *) (bytes + sizeof(u16) + sizeof(uint32_t)));
+        offset += unmarshal_value(bytes, col_num, nullptr, nullptr);
+    }
+}
+
+/**
+ * Constructor
+ * @param table         table to scan
+ * @param where         predicates to match, or nullptr for all rows
+ * @param column_names  columns to project in next(handle, row), or nullptr for all
+ * @param first         first block to scan, or 0 to start at the beginning of the file
+ * @param last          final block to scan, or 0 to go to the end of the file
+ */
+HeapTableCursor::HeapTableCursor(HeapTable *table, const ValueDict *where, const ColumnNames *column_names,
+                                 BlockID first, BlockID last)
+        : table(table), where(table->predicate(where)), column_names(column_names),
+          projected(table->ordinals(column_names)), block_id(first == 0 ? 0 : first - 1), block(nullptr),
+          record_id(0), prefetched(0), last(last) {
+    if (column_names == nullptr || column_names->empty())
+        this->column_names = &table->column_names;
+}
+
+/**
+ * Destructor - releases the current block.
+ */
+HeapTableCursor::~HeapTableCursor() {
+    delete this->block;
+}
+
+/**
+ * Advance to the next row that satisfies the where clause.
+ * @param handle  set to the row's handle
+ * @return        false when the scan is exhausted
+ */
+bool HeapTableCursor::next(Handle &handle) {
+    return advance(handle, nullptr, nullptr);
+}
+
+/**
+ * Advance to the next row that satisfies the where clause and project it.
+ * @param handle  set to the row's handle
+ * @param row     set to the projected row (freed by caller)
+ * @return        false when the scan is exhausted
+ */
+bool HeapTableCursor::next(Handle &handle, Row *&row) {
+    return advance(handle, &row, nullptr);
+}
+
+/**
+ * Advance to the next row that satisfies the where clause and decode its projection in place.
+ * @param handle  set to the row's handle
+ * @param row     set to views of the projected values (valid until the next call)
+ * @return        false when the scan is exhausted
+ */
+bool HeapTableCursor::next(Handle &handle, ValueViews &row) {
+    return advance(handle, nullptr, &row);
+}
+
+/**
+ * Step through the records of the pinned block, testing the where clause on each record's
+ * bytes and unmarshalling only the ones that pass. Moves on to the next block when this one is used up.
+ * @param handle  set to the qualifying row's handle
+ * @param row     if not nullptr, set to the projected row
+ * @param values  if not nullptr, set to views of the projected values
+ * @return        false when the scan is exhausted
+ */
+bool HeapTableCursor::advance(Handle &handle, Row **row, ValueViews *values) {
+    while (true) {
+        if (this->block == nullptr) {
+            this->block_id = this->table->file->next_block_id(this->block_id);
+            if (this->block_id == 0 || (this->last != 0 && this->block_id > this->last))
+                return false;
+            if (this->block_id >= this->prefetched) {
+                uint window = this->table->file->get_read_ahead();
+                if (this->last != 0)
+                    window = min(window, this->last - this->block_id + 1);
+                if (window > 1)
+                    this->table->file->prefetch(this->block_id, window);
+                this->prefetched = this->block_id + max(window, 1U);
+            }
+            this->block = this->table->file->get(this->block_id);
+            this->record_id = 0;
+        }
+        this->record_id = this->block->next_id(this->record_id);
+        if (this->record_id == 0) {
+            delete this->block;
+            this->block = nullptr;
+            continue;
+        }
+        if (this->where.empty() && row == nullptr && values == nullptr) {
+            handle = Handle(this->block_id, this->record_id);  // no need to look at the data
+            return true;
+        }
+        RecordView record = this->block->view(this->record_id);
+        if (this->where.matches(record)) {
+            handle = Handle(this->block_id, this->record_id);
+            if (row != nullptr)
+                *row = this->table->unmarshal(record, this->column_names, this->projected);
+            if (values != nullptr)
+                this->table->unmarshal(record, this->projected, *values, this->out_of_line);
+            return true;
+        }
+    }
 }
 
 /**
@@ -416,7 +1032,388 @@ bool test_heap_storage() {
             return false;
     }
     cout << "del ok" << endl;
+
+    DbCursor *rows = table.cursor();
+    Handle handle;
+    i = -1;
+    while (rows->next(handle)) {
+        if (!test_compare(table, handle, i++, b)) {
+            delete rows;
+            return false;
+        }
+    }
+    delete rows;
+    if (i != 999)
+        return false;
+    cout << "cursor ok" << endl;
+
+    ColumnNames c_only;
+    c_only.push_back("c");
+    ValueDict *projected = table.project((*handles)[1], &c_only);
+    bool projected_ok = projected->size() == 1 && projected->at("c").n == 1;
+    delete projected;
+    if (!projected_ok)
+        return false;
+    cout << "project ok" << endl;
+
+    ColumnNames a_and_b;
+    a_and_b.push_back("a");
+    a_and_b.push_back("b");
+    rows = table.cursor(nullptr, &a_and_b);
+    ValueViews views;
+    i = -1;
+    while (rows->next(handle, views)) {
+        if (views.size() != 2 || views[0].n != i++ || views[1] != Value(b)) {
+            delete rows;
+            return false;
+        }
+    }
+    delete rows;
+    if (i != 999)
+        return false;
+    cout << "cursor views ok" << endl;
+
+    ValueDict where;
+    where["a"] = Value(500);
+    where["b"] = Value(b);
+    Handles *selected = table.select(&where);
+    bool selected_ok = selected->size() == 1 && test_compare(table, (*selected)[0], 500, b);
+    delete selected;
+    if (!selected_ok)
+        return false;
+    cout << "select where ok" << endl;
+
+    Handle first_handle = (*handles)[0];
+    table.del(first_handle);
+    test_set_row(row, -1, b);
+    Handle reused = table.insert(&row);
+    if (reused.first != first_handle.first)
+        return false;
+    cout << "free space reuse ok" << endl;
+
+    ValueDicts batch;
+    for (int j = 0; j < 100; j++) {
+        ValueDict *batch_row = new ValueDict();
+        test_set_row(*batch_row, j, b);
+        batch.push_back(batch_row);
+    }
+    Handles *batch_handles = table.insert_batch(&batch);
+    for (auto const &batch_row: batch)
+        delete batch_row;
+    bool batch_ok = batch_handles->size() == 100;
+    for (int j = 0; batch_ok && j < 100; j++)
+        batch_ok = test_compare(table, (*batch_handles)[j], j, b);
+    delete batch_handles;
+    if (!batch_ok)
+        return false;
+    cout << "insert_batch ok" << endl;
+
+    table.flush();  // the insertion page is written back, so another handle on the file sees every row
+    HeapTable same_table("_test_data_cpp", column_names, column_attributes);
+    Handles *flushed = same_table.select();
+    bool flush_ok = flushed->size() == 1100 && same_table.get_row_count() == 1100;
+    delete flushed;
+    same_table.close();
+    if (!flush_ok)
+        return false;
+    cout << "flush ok" << endl;
     table.drop();
     delete handles;
+
+    HeapTable big_table("_test_big_blocks_cpp", column_names, column_attributes, 4 * DbBlock::BLOCK_SZ);
+    big_table.create();
+    string big_b(DbBlock::BLOCK_SZ, 'x');  // kept in the row, which would not fit in a 4kB block
+    test_set_row(row, 7, big_b);
+    Handle big_handle = big_table.insert(&row);
+    bool big_ok = test_compare(big_table, big_handle, 7, big_b);
+    big_table.drop();
+    if (!big_ok)
+        return false;
+    cout << "big blocks ok" << endl;
+
+    HeapTable overflow_table("_test_overflow_cpp", column_names, column_attributes);
+    overflow_table.create();
+    string huge_b(100000, 'y');  // more than a block and more than a 16-bit length
+    test_set_row(row, 8, huge_b);
+    Handle huge_handle = overflow_table.insert(&row);
+    bool overflow_ok = test_compare(overflow_table, huge_handle, 8, huge_b);
+    where.clear();
+    where["b"] = Value(huge_b);
+    Handles *found = overflow_table.select(&where);
+    overflow_ok = overflow_ok && found->size() == 1;
+    delete found;
+    char pointer_bytes[4 + 2 + OverflowFile::POINTER_SZ + 1] = {};  // a record with b out of line
+    *(uint16_t *) (pointer_bytes + 4) = OverflowFile::TEXT_MARKER;
+    *(uint32_t *) (pointer_bytes + 6) = (uint32_t) huge_b.size();
+    RecordPredicate no_fetch(column_attributes);  // no overflow file: would throw if it fetched the value
+    no_fetch.add(1, RecordPredicate::EQ, Value("y"));
+    overflow_ok = overflow_ok && !no_fetch.matches(RecordView(pointer_bytes, sizeof(pointer_bytes)));
+    overflow_table.del(huge_handle);
+    huge_handle = overflow_table.insert(&row);  // reuses the freed overflow pages
+    overflow_ok = overflow_ok && test_compare(overflow_table, huge_handle, 8, huge_b);
+    string spare_b(100000, 'z');
+    test_set_row(row, 9, spare_b);
+    Handle spare_handle = overflow_table.insert(&row);
+    overflow_table.del(huge_handle);
+    overflow_table.close();  // the overflow file's size and free list are in the header now
+    HeapTable reopened_table("_test_overflow_cpp", column_names, column_attributes);
+    reopened_table.open();
+    test_set_row(row, 8, huge_b);
+    huge_handle = reopened_table.insert(&row);  // reuses the freed pages, not those of spare_b
+    overflow_ok = overflow_ok && test_compare(reopened_table, huge_handle, 8, huge_b)
+                  && test_compare(reopened_table, spare_handle, 9, spare_b);
+    reopened_table.close();
+    overflow_table.drop();
+    ColumnNames wide_names;
+    ColumnAttributes wide_attributes(4, ColumnAttribute(ColumnAttribute::TEXT));
+    ValueDict wide_row;
+    for (uint i = 0; i < 4; i++) {
+        wide_names.push_back(string("t") + to_string(i));
+        wide_row[wide_names[i]] = Value(string(DbBlock::BLOCK_SZ / 4 - i, (char) ('a' + i)));
+    }
+    HeapTable wide_table("_test_wide_cpp", wide_names, wide_attributes);  // no one value is big, but together
+    wide_table.create();
+    Handle wide_handle = wide_table.insert(&wide_row);
+    ValueDict *wide_result = wide_table.project(wide_handle);
+    overflow_ok = *wide_result == wide_row;
+    delete wide_result;
+    wide_table.drop();
+    if (!overflow_ok)
+        return false;
+    cout << "overflow ok" << endl;
+
+    HeapTable *mmap_table = new HeapTable("_test_mmap_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                          HeapTable::MMAP);
+    mmap_table->create();
+    for (int j = 0; j < 1000; j++) {
+        test_set_row(row, j, b);
+        mmap_table->insert(&row);
+    }
+    mmap_table->close();
+    delete mmap_table;
+    mmap_table = new HeapTable("_test_mmap_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                               HeapTable::MMAP);
+    mmap_table->open();
+    handles = mmap_table->select();
+    bool mmap_ok = handles->size() == 1000;
+    for (int j = 0; mmap_ok && j < 1000; j++)
+        mmap_ok = test_compare(*mmap_table, (*handles)[j], j, b);
+    delete handles;
+    mmap_table->drop();
+    delete mmap_table;
+    if (!mmap_ok)
+        return false;
+    cout << "mmap ok" << endl;
+
+    HeapTable *async_table = new HeapTable("_test_async_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                           HeapTable::ASYNC_IO);
+    async_table->create();
+    for (int j = 0; j < 1000; j++) {
+        test_set_row(row, j, b);
+        async_table->insert(&row);
+    }
+    async_table->close();
+    delete async_table;
+    async_table = new HeapTable("_test_async_cpp", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                HeapTable::ASYNC_IO);
+    async_table->open();
+    u_long read_ahead = BufferPool::get_pool().get_stats().read_ahead;
+    handles = async_table->select();  // the cursor reads these in batches
+    bool async_ok = handles->size() == 1000 && BufferPool::get_pool().get_stats().read_ahead > read_ahead;
+    for (int j = 0; async_ok && j < 1000; j++)
+        async_ok = test_compare(*async_table, (*handles)[j], j, b);
+    delete handles;
+    async_table->drop();
+    delete async_table;
+    if (!async_ok)
+        return false;
+    cout << "async io ok" << endl;
+
+    FileManager &files = FileManager::get_manager();
+    uint max_open = files.get_max_open();
+    files.set_max_open(2);
+    vector<HeapTable *> many_tables;
+    for (int j = 0; j < 3; j++) {
+        many_tables.push_back(new HeapTable("_test_many_" + to_string(j) + "_cpp", column_names, column_attributes));
+        many_tables[j]->create();
+        test_set_row(row, j, b);
+        many_tables[j]->insert(&row);
+        many_tables[j]->flush();  // lets go of the insertion page, so the file can be closed
+    }
+    bool files_ok = files.get_open_count() == 2;
+    handles = many_tables[0]->select();  // closed to make room for the third, so it opens again
+    files_ok = files_ok && handles->size() == 1 && test_compare(*many_tables[0], (*handles)[0], 0, b);
+    files_ok = files_ok && files.get_open_count() == 2;
+    delete handles;
+    files.set_max_open(many_tables.size() + 1);
+    many_tables.push_back(new HeapTable("_test_many_3_cpp", column_names, column_attributes));
+    many_tables[3]->create();
+    many_tables[3]->insert(&row);  // keeps its insertion page pinned, so it can't be closed
+    for (int j = 0; j < 3; j++)
+        delete many_tables[j]->select();
+    files.set_max_open(1);  // closes the other three at once, passing over the one in use
+    files_ok = files_ok && files.get_open_count() == 1;
+    many_tables[3]->flush();
+    for (HeapTable *many_table: many_tables) {
+        handles = many_table->select();
+        files_ok = files_ok && handles->size() == 1;
+        delete handles;
+    }
+    for (HeapTable *many_table: many_tables) {
+        many_table->drop();
+        delete many_table;
+    }
+    files.set_max_open(max_open);
+    if (!files_ok)
+        return false;
+    cout << "file manager ok" << endl;
+
+    HeapTable parallel_table("_test_parallel_cpp", column_names, column_attributes);
+    parallel_table.create();
+    string long_b(300, 'p'), other_b(300, 'q');  // a dozen rows a block, so the table has many morsels
+    for (int j = 0; j < 3000; j++) {
+        test_set_row(row, j, j % 2 == 0 ? long_b : other_b);
+        parallel_table.insert(&row);
+    }
+    where.clear();
+    where["b"] = Value(long_b);
+    ColumnNames just_a(1, "a");
+    Handles parallel_handles;
+    Rows *parallel_rows = parallel_table.parallel_select(&where, &just_a, &parallel_handles, 4);
+    handles = parallel_table.select(&where);
+    bool parallel_ok = parallel_rows->size() == 1500 && parallel_handles == *handles;
+    for (uint j = 0; parallel_ok && j < parallel_rows->size(); j++)
+        parallel_ok = (*parallel_rows)[j]->at("a").n == (int) (2 * j);
+    for (auto const &parallel_row: *parallel_rows)
+        delete parallel_row;
+    delete parallel_rows;
+    delete handles;
+    parallel_table.drop();
+    if (!parallel_ok)
+        return false;
+    cout << "parallel select ok" << endl;
+
+    HeapTable shared_table("_test_shared_cpp", column_names, column_attributes);
+    shared_table.create();
+    const int writers = 4, rows_each = 1000;
+    vector<Handles> written(writers);
+    vector<thread> writer_threads;
+    for (int w = 0; w < writers; w++)
+        writer_threads.push_back(thread([&shared_table, &written, &b, w]() {
+            ValueDict writer_row;
+            for (int j = 0; j < rows_each; j++) {
+                test_set_row(writer_row, w * rows_each + j, b);
+                written[w].push_back(shared_table.insert(&writer_row));
+            }
+        }));
+    for (auto &writer_thread: writer_threads)
+        writer_thread.join();
+    shared_table.flush();
+    handles = shared_table.select();
+    bool shared_ok = handles->size() == writers * rows_each && shared_table.get_row_count() == writers * rows_each;
+    delete handles;
+    for (int w = 0; shared_ok && w < writers; w++)
+        for (int j = 0; shared_ok && j < rows_each; j++)
+            shared_ok = test_compare(shared_table, written[w][j], w * rows_each + j, b);
+    shared_table.drop();
+    if (!shared_ok)
+        return false;
+    cout << "concurrent inserts ok" << endl;
     return true;
-}
\ No newline at end of file
+}
+/**
+ * Time a full scan and a run of random point reads against a table.
+ * @param table        table to read
+ * @param handles      its rows
+ * @param scan_ms      set to milliseconds for the scan
+ * @param parallel_ms  set to milliseconds for the same scan done by parallel_select
+ * @param project_ms   set to milliseconds for the point reads
+ */
+static void benchmark_reads(HeapTable &table, const Handles &handles, double &scan_ms, double &parallel_ms,
+                            double &project_ms) {
+    typedef chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    DbCursor *rows = table.cursor();
+    Handle handle;
+    ValueViews views;
+    long sum = 0;
+    while (rows->next(handle, views))
+        sum += views[0].n;
+    delete rows;
+    scan_ms = chrono::duration<double, milli>(clock::now() - start).count();
+
+    start = clock::now();
+    Rows *all = table.parallel_select(nullptr);
+    for (auto const &row: *all) {
+        sum += (*row)[0].n;
+        delete row;
+    }
+    delete all;
+    parallel_ms = chrono::duration<double, milli>(clock::now() - start).count();
+
+    srand(5300);
+    start = clock::now();
+    for (uint i = 0; i < handles.size(); i++) {
+        ValueDict *row = table.project(handles[rand() % handles.size()]);
+        sum += row->at("a").n;
+        delete row;
+    }
+    project_ms = chrono::duration<double, milli>(clock::now() - start).count();
+    if (sum == -1)
+        cout << sum;  // keep the reads from being optimized away
+}
+
+/**
+ * Compare the Berkeley DB and memory-mapped storage engines on scans and point reads of the
+ * same rows. Each table is closed and reopened before it is read, so the first pass starts
+ * cold in our buffer pool.
+ * @return true if both engines returned all the rows
+ */
+bool benchmark_heap_engines() {
+    const int num_rows = 100000;
+    ColumnNames column_names;
+    column_names.push_back("a");
+    column_names.push_back("b");
+    ColumnAttributes column_attributes;
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::INT));
+    column_attributes.push_back(ColumnAttribute(ColumnAttribute::TEXT));
+
+    const HeapTable::Engine engines[] = {HeapTable::BERKELEY_DB, HeapTable::MMAP, HeapTable::ASYNC_IO};
+    const char *engine_names[] = {"berkeley db", "mmap", AsyncIO::get().is_async() ? "io_uring" : "pread"};
+    for (int e = 0; e < 3; e++) {
+        HeapTable *table = new HeapTable("_benchmark_engines", column_names, column_attributes, DbBlock::BLOCK_SZ,
+                                         engines[e]);
+        table->create();
+        ValueDicts rows;
+        for (int i = 0; i < num_rows; i++) {
+            ValueDict *row = new ValueDict();
+            (*row)["a"] = Value(i);
+            (*row)["b"] = Value("row number " + to_string(i));
+            rows.push_back(row);
+        }
+        delete table->insert_batch(&rows);
+        for (auto const &row: rows)
+            delete row;
+        table->close();
+        delete table;
+
+        table = new HeapTable("_benchmark_engines", column_names, column_attributes, DbBlock::BLOCK_SZ, engines[e]);
+        table->open();
+        const BufferPoolStats &stats = BufferPool::get_pool().get_stats();
+        u_long read_ahead = stats.read_ahead, read_ahead_hits = stats.read_ahead_hits;
+        Handles *handles = table->select();
+        bool ok = handles->size() == (uint) num_rows;
+        double scan_ms, parallel_ms, project_ms;
+        benchmark_reads(*table, *handles, scan_ms, parallel_ms, project_ms);
+        cout << engine_names[e] << ": scan " << scan_ms << " ms, parallel scan " << parallel_ms << " ms, "
+             << num_rows << " point reads " << project_ms << " ms, read ahead " << stats.read_ahead - read_ahead << " blocks ("
+             << stats.read_ahead_hits - read_ahead_hits << " used) in windows of " << HeapFile::DEFAULT_READ_AHEAD
+             << endl;
+        delete handles;
+        table->drop();
+        delete table;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
@@ -7,19 +7,57 @@
  */
 #pragma once
 
+#include <map>
+#include <mutex>
+#include <thread>
 #include "storage_engine.h"
 #include "SlottedPage.h"
 #include "HeapFile.h"
+#include "MmapFile.h"
+#include "AsyncFile.h"
+#include "RecordPredicate.h"
+
+class HeapTableCursor;  // forward declare
 
 /**
  * @class HeapTable - Heap storage engine (implementation of DbRelation)
+ *
+ * Inserts go into an insertion page that stays pinned from one insert to the next, so a run
+ * of inserts fetches and puts each block once. The page is put back when it fills and on
+ * flush, close and any other change to the table.
+ * Several threads may insert at once: each has an insertion page of its own, and no two
+ * threads' pages are ever the same block, so the inserts themselves don't wait on each other.
+ * Only picking a new page when one fills is done under a latch. Deletes, flush and close must
+ * not run at the same time as inserts.
+ *
+ * A big scan can be spread over several threads with parallel_select. Changes to the table
+ * must not run at the same time as one.
+ *
+ * Indices given to add_index are kept up to date: insert, insert_batch and del pass the rows'
+ * handles on to each of them (a batch all at once, so an index can sort its entries and visit
+ * each of its blocks once). If an index refuses a row, e.g. a duplicate key in a unique index,
+ * the insert is undone and the error passed on. Index updates take turns under a latch.
  */
 
 class HeapTable : public DbRelation {
 public:
-    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes);
+    /**
+     * Number of blocks in each of the runs a parallel_select deals out to its workers
+     */
+    static const uint MORSEL_BLOCKS = 16;
+
+    /**
+     * How the table's blocks are stored: in a Berkeley DB file through the buffer pool, in
+     * a memory-mapped file (see MmapFile), or in a plain file read in batches (see AsyncFile).
+     */
+    enum Engine {
+        BERKELEY_DB, MMAP, ASYNC_IO
+    };
+
+    HeapTable(Identifier table_name, ColumnNames column_names, ColumnAttributes column_attributes,
+              uint block_size = DbBlock::BLOCK_SZ, Engine engine = BERKELEY_DB);
 
-    virtual ~HeapTable() {}
+    virtual ~HeapTable();
 
     HeapTable(const HeapTable &other) = delete;
 
@@ -39,8 +77,12 @@ public:
 
     virtual void close();
 
+    virtual void flush();
+
     virtual Handle insert(const ValueDict *row);
 
+    virtual Handles *insert_batch(const ValueDicts *rows);
+
     virtual void update(const Handle handle, const ValueDict *new_values);
 
     virtual void del(const Handle handle);
@@ -49,25 +91,141 @@ public:
 
     virtual Handles *select(const ValueDict *where);
 
+    virtual DbCursor *cursor(const ValueDict *where = nullptr, const ColumnNames *column_names = nullptr);
+
+    virtual Rows *parallel_select(const ValueDict *where, const ColumnNames *column_names = nullptr,
+                                  Handles *handles = nullptr, uint threads = 0);
+
     virtual ValueDict *project(Handle handle);
 
     virtual ValueDict *project(Handle handle, const ColumnNames *column_names);
 
     using DbRelation::project;
 
+    virtual void add_index(DbIndex *index);
+
+    virtual void remove_index(DbIndex *index);
+
+    /**
+     * Number of indices being kept up to date.
+     * @return index count
+     */
+    virtual uint get_index_count() const { return (uint) indices.size(); }
+
+    /**
+     * Set how many blocks ahead scans of this table read (0 turns read-ahead off).
+     * @param blocks  read-ahead window
+     */
+    virtual void set_read_ahead(uint blocks) { file->set_read_ahead(blocks); }
+
+    /**
+     * Number of rows in the table, from the file's header (no scan needed).
+     * @return row count
+     */
+    virtual uint64_t get_row_count() {
+        open();
+        return file->get_row_count();
+    }
+
 protected:
-    HeapFile file;
+    HeapFile *file;
+    std::map<std::thread::id, SlottedPage *> insert_pages;  // each inserting thread's page, kept pinned
+    std::mutex insert_latch;   // guards insert_pages and the choice of blocks for them
+    std::vector<DbIndex *> indices;  // kept up to date with the rows
+    std::mutex index_latch;    // one thread at a time updates the indices
+
+    virtual void index_rows(const Handles &handles);
+
+    virtual void erase(const Handles &handles);
+
+    virtual Row *validate(const ValueDict *row) const;
+
+    virtual Handle append(const Row *row);
+
+    virtual Handle place(const Dbt *data);
+
+    virtual SlottedPage *&own_insert_page();
+
+    virtual void release_insert_page(SlottedPage *&page);
+
+    virtual void release_insert_pages();
+
+    virtual bool is_insert_page(BlockID block_id) const;
 
-    virtual ValueDict *validate(const ValueDict *row) const;
+    virtual SlottedPage *block_for(uint size);
 
-    virtual Handle append(const ValueDict *row);
+    virtual Dbt *marshal(const Row *row);
 
-    virtual Dbt *marshal(const ValueDict *row) const;
+    virtual uint marshal(const Row *row, char *bytes);
 
-    virtual ValueDict *unmarshal(Dbt *data) const;
+    virtual Row *unmarshal(const RecordView &record);
 
-    virtual bool selected(Handle handle, const ValueDict *where);
+    virtual Row *unmarshal(const RecordView &record, const ColumnNames *column_names, const ColumnOrdinals &ordinals);
+
+    virtual void unmarshal(const RecordView &record, const ColumnOrdinals &ordinals, ValueViews &values,
+                           std::vector<std::string> &out_of_line);
+
+    virtual uint unmarshal_value(const char *bytes, uint col_num, ValueView *value, std::string *out_of_line);
+
+    virtual void free_out_of_line(const RecordView &record);
+
+    virtual Row *project_row(Handle handle, const ColumnNames *column_names);
+
+    virtual ColumnOrdinals ordinals(const ColumnNames *column_names) const;
+
+    virtual RecordPredicate predicate(const ValueDict *where);
+
+    friend class HeapTableCursor;
+};
+
+/**
+ * @class HeapTableCursor - streams the qualifying handles of a HeapTable
+ *
+ * Walks the file's blocks in order, keeping only the current block pinned, so memory use
+ * does not grow with the size of the table and the first row is available right away.
+ * The where clause is checked against each record's bytes in the pinned block, and only the
+ * requested columns of the records that pass are unmarshalled. The scan tells the file it is
+ * reading sequentially by prefetching a read-ahead window of blocks each time it reaches the
+ * end of the last one. A cursor can be limited to a range of blocks, which is how
+ * parallel_select splits up a scan.
+ */
+class HeapTableCursor : public DbCursor {
+public:
+    HeapTableCursor(HeapTable *table, const ValueDict *where, const ColumnNames *column_names, BlockID first = 0,
+                    BlockID last = 0);
+
+    virtual ~HeapTableCursor();
+
+    HeapTableCursor(const HeapTableCursor &other) = delete;
+
+    HeapTableCursor(HeapTableCursor &&temp) = delete;
+
+    HeapTableCursor &operator=(const HeapTableCursor &other) = delete;
+
+    HeapTableCursor &operator=(HeapTableCursor &&temp) = delete;
+
+    virtual bool next(Handle &handle);
+
+    virtual bool next(Handle &handle, Row *&row);
+
+    virtual bool next(Handle &handle, ValueViews &row);
+
+protected:
+    HeapTable *table;
+    RecordPredicate where;        // empty for all rows
+    const ColumnNames *column_names;  // names for the projected rows
+    ColumnOrdinals projected;     // table ordinal of each projected column
+    std::vector<std::string> out_of_line;  // backs the views of any out-of-line values
+    BlockID block_id;
+    SlottedPage *block;
+    RecordID record_id;
+    BlockID prefetched;           // blocks before this one have been read ahead
+    BlockID last;                 // final block to scan, or 0 to go to the end of the file
+
+    virtual bool advance(Handle &handle, Row **row, ValueViews *values);
 };
 
 bool test_heap_storage();
 
+bool benchmark_heap_engines();
+
@@ -0,0 +1,124 @@
+/**
+ * @file KeySorter.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <algorithm>
+#include "KeySorter.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+/**
+ * Constructor
+ * @param profile  types of the key columns
+ * @param memory   about how many bytes of keys to hold before spilling a run
+ */
+KeySorter::KeySorter(const KeyProfile &profile, uint memory)
+        : profile(profile), memory(memory), held(0), keys(), position(0), runs(), heads() {
+}
+
+KeySorter::~KeySorter() {
+    for (auto const &run: this->runs)
+        fclose(run);  // tmpfile removes itself
+}
+
+/**
+ * Add a key, spilling the keys held so far as a run if they are over the budget.
+ * @param key  the key
+ */
+void KeySorter::add(const BTreeKey &key) {
+    this->keys.push_back(key);
+    this->held += sizeof(BTreeKey) + BTreeNode::key_size(this->profile, key) + key.first.size() * sizeof(Value);
+    if (this->held > this->memory)
+        spill();
+}
+
+/**
+ * Sort the held keys. If runs were spilled, spill these too and start merging.
+ */
+void KeySorter::finish() {
+    if (this->runs.empty()) {
+        sort();
+        this->position = 0;
+        return;
+    }
+    if (!this->keys.empty())
+        spill();
+    for (uint run = 0; run < this->runs.size(); run++) {
+        rewind(this->runs[run]);
+        BTreeKey key;
+        if (read_key(run, key))
+            this->heads.push(Head(key, run));
+    }
+}
+
+/**
+ * Next key in order: from memory if nothing was spilled, else the least of the runs' heads.
+ * @param key  set to the key
+ * @return     false if there are no more
+ */
+bool KeySorter::next(BTreeKey &key) {
+    if (this->runs.empty()) {
+        if (this->position == this->keys.size())
+            return false;
+        key = this->keys[this->position++];
+        return true;
+    }
+    if (this->heads.empty())
+        return false;
+    Head head = this->heads.top();
+    this->heads.pop();
+    key = head.first;
+    if (read_key(head.second, head.first))
+        this->heads.push(head);
+    return true;
+}
+
+/**
+ * Sort the held keys.
+ */
+void KeySorter::sort() {
+    std::sort(this->keys.begin(), this->keys.end(),
+              [](const BTreeKey &a, const BTreeKey &b) { return BTreeNode::compare(a, b) < 0; });
+}
+
+/**
+ * Sort the held keys and write them to a new run file, each as a 2-byte length followed by
+ * the key marshalled as for a node.
+ * @throws DbRelationError if the run file can't be made or written
+ */
+void KeySorter::spill() {
+    sort();
+    FILE *run = tmpfile();
+    if (run == nullptr)
+        throw DbRelationError("can't make a temporary file to sort index keys");
+    this->runs.push_back(run);
+    string bytes;
+    for (auto const &key: this->keys) {
+        bytes.clear();
+        BTreeNode::marshal_key(this->profile, key, bytes);
+        u16 size = (u16) bytes.size();
+        if (fwrite(&size, sizeof(size), 1, run) != 1 || fwrite(bytes.data(), 1, size, run) != size)
+            throw DbRelationError("can't write to the temporary file sorting index keys");
+    }
+    this->keys.clear();
+    this->keys.shrink_to_fit();
+    this->held = 0;
+}
+
+/**
+ * Read the next key from a run.
+ * @param run  which run
+ * @param key  set to the key
+ * @return     false at the end of the run
+ */
+bool KeySorter::read_key(uint run, BTreeKey &key) {
+    u16 size;
+    if (fread(&size, sizeof(size), 1, this->runs[run]) != 1)
+        return false;
+    string bytes(size, '\0');
+    if (fread(&bytes[0], 1, size, this->runs[run]) != size)
+        throw DbRelationError("can't read the temporary file sorting index keys");
+    BTreeNode::unmarshal_key(this->profile, bytes.data(), key);
+    return true;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file KeySorter.h - External sort of index keys.
+ * KeySorter
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <cstdio>
+#include <queue>
+#include <vector>
+#include "BTreeNode.h"
+
+/**
+ * @class KeySorter - sorts a stream of B+tree keys too big to hold in memory
+ *
+ * Keys are added one at a time. Once the ones held take up more than the memory budget, they
+ * are sorted and written out as a run to a temporary file. After finish, next hands back all
+ * the keys in order, merging the runs if there are any (so a sort that fits in memory never
+ * touches the disk). Run files are removed when the sorter is destroyed.
+ */
+class KeySorter {
+public:
+    /**
+     * Default memory budget in bytes
+     */
+    static const uint DEFAULT_MEMORY = 64 * 1024 * 1024;
+
+    /**
+     * Constructor
+     * @param profile  types of the key columns
+     * @param memory   about how many bytes of keys to hold before spilling a run
+     */
+    KeySorter(const KeyProfile &profile, uint memory = DEFAULT_MEMORY);
+
+    virtual ~KeySorter();
+
+    KeySorter(const KeySorter &other) = delete;
+
+    KeySorter(KeySorter &&temp) = delete;
+
+    KeySorter &operator=(const KeySorter &other) = delete;
+
+    KeySorter &operator=(KeySorter &&temp) = delete;
+
+    /**
+     * Add a key to be sorted.
+     * @param key  the key
+     */
+    virtual void add(const BTreeKey &key);
+
+    /**
+     * Done adding; sort what is held and get ready to hand the keys back.
+     */
+    virtual void finish();
+
+    /**
+     * Get the next key in order (after finish).
+     * @param key  set to the key
+     * @returns    false if there are no more
+     */
+    virtual bool next(BTreeKey &key);
+
+    /**
+     * Number of runs spilled to disk.
+     * @returns  run count
+     */
+    virtual uint get_run_count() const { return (uint) runs.size(); }
+
+protected:
+    typedef std::pair<BTreeKey, uint> Head;  // the next key from a run, and which run
+
+    struct Later {
+        bool operator()(const Head &a, const Head &b) const { return BTreeNode::compare(a.first, b.first) > 0; }
+    };
+
+    const KeyProfile &profile;
+    uint memory;
+    uint held;                       // bytes of the keys held, roughly
+    std::vector<BTreeKey> keys;      // held keys
+    uint position;                   // next of the held keys to hand back
+    std::vector<FILE *> runs;
+    std::priority_queue<Head, std::vector<Head>, Later> heads;
+
+    virtual void sort();
+
+    virtual void spill();
+
+    virtual bool read_key(uint run, BTreeKey &key);
+};
@@ -0,0 +1,263 @@
+/**
+ * @file MmapFile.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "MmapFile.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name
+ * @param block_size  bytes per block if the file gets created (an existing file keeps its own)
+ * @throws std::invalid_argument if block_size isn't 4, 8, 16 or 32kB
+ */
+MmapFile::MmapFile(string name, uint block_size) : HeapFile(name, block_size), path(""), fd(-1), base(nullptr),
+                                                   mapped(0) {
+    this->first_block = 1;
+    this->dbfilename = this->name + ".mmap";
+    const char *home = nullptr;
+    _DB_ENV->get_home(&home);
+    this->path = home == nullptr ? this->dbfilename : string(home) + "/" + this->dbfilename;
+}
+
+/**
+ * Destructor - let go of the mapping (what we wrote to it is already in the page cache).
+ */
+MmapFile::~MmapFile() {
+    if (!this->closed) {
+        write_header();
+        unmap();
+        ::close(this->fd);
+        this->closed = true;
+    }
+}
+
+/**
+ * Delete the physical file.
+ */
+void MmapFile::drop(void) {
+    if (!this->closed) {  // no point writing back the header or syncing blocks we are about to remove
+        unmap();
+        ::close(this->fd);
+        this->fd = -1;
+        this->closed = true;
+    }
+    this->files.closed(this);
+    unlink(this->path.c_str());
+    this->fsm.drop();
+    this->overflow.drop();
+}
+
+/**
+ * Write everything back and close the physical file.
+ */
+void MmapFile::close(void) {
+    if (!this->closed) {
+        write_header();
+        msync(this->base, this->mapped, MS_SYNC);
+        unmap();
+        ::close(this->fd);
+        this->fd = -1;
+        this->closed = true;
+    }
+    this->fsm.close();
+    this->overflow.close();
+    this->files.closed(this);
+}
+
+/**
+ * Write the mapped blocks and the side files' dirty pages to disk.
+ */
+void MmapFile::flush(void) {
+    if (this->closed)
+        return;
+    write_header();
+    msync(this->base, this->mapped, MS_SYNC);
+    this->fsm.flush();
+    this->overflow.flush();
+}
+
+/**
+ * Allocate a new block at the end of the file, growing the file and its mapping if need be.
+ * @return the new empty block (freed by caller)
+ */
+SlottedPage *MmapFile::get_new(void) {
+    open();
+    lock_guard<mutex> lock(this->space_latch);  // growing the mapping isn't safe to do twice at once
+    BlockID block_id = this->last + 1;
+    grow((size_t) (block_id + 1) * this->block_size);
+    this->last = block_id;
+    write_header();
+    char *bytes = this->base + (size_t) block_id * this->block_size;
+    memset(bytes, 0, this->block_size);
+    Dbt data(bytes, this->block_size);
+    SlottedPage *page = new SlottedPage(data, block_id, true, nullptr);
+    this->free_bytes += this->fsm.set(block_id, page->free_space());
+    return page;
+}
+
+/**
+ * Get a block from the file. The page works directly on the mapped memory.
+ * @param block_id
+ * @return          the given slotted page (freed by caller)
+ */
+SlottedPage *MmapFile::get(BlockID block_id) {
+    open();
+    if (block_id == 0 || block_id > this->last)
+        throw DbRelationError("no block " + to_string(block_id) + " in " + this->dbfilename);
+    Dbt data(this->base + (size_t) block_id * this->block_size, this->block_size);
+    return new SlottedPage(data, block_id, false, nullptr);
+}
+
+/**
+ * Write a block back to the file. A page we handed out has been changed in place already, so
+ * this just keeps the free-space map up to date; any other block is copied into the mapping.
+ * @param block
+ */
+void MmapFile::put(DbBlock *block) {
+    open();
+    BlockID block_id = block->get_block_id();
+    if (block_id == 0 || block_id > this->last)
+        throw DbRelationError("no block " + to_string(block_id) + " in " + this->dbfilename);
+    SlottedPage *page = (SlottedPage *) block;
+    {
+        lock_guard<mutex> lock(this->space_latch);
+        this->free_bytes += this->fsm.set(block_id, page->free_space());
+    }
+    char *bytes = this->base + (size_t) block_id * this->block_size;
+    if (block->get_data() != bytes)
+        memcpy(bytes, block->get_data(), this->block_size);
+}
+
+/**
+ * Ask the operating system to start reading in a run of blocks that a scan is about to touch.
+ * @param first  first block id of the run
+ * @param count  number of blocks in it (cut short at the end of the file)
+ */
+void MmapFile::prefetch(BlockID first, uint count) {
+    open();
+    if (first == 0 || first > this->last || count == 0)
+        return;
+    count = min(count, this->last - first + 1);
+    madvise(this->base + (size_t) first * this->block_size, (size_t) count * this->block_size, MADV_WILLNEED);
+}
+
+/**
+ * Pages handed out point straight into the mapping and we don't know when they are freed, so
+ * the FileManager is never allowed to close (and unmap) an open file.
+ * @return true while the file is open
+ */
+bool MmapFile::in_use() const {
+    return !this->closed;
+}
+
+/**
+ * Open the file and map it, creating it first if asked to.
+ * @param flags  DB_CREATE to make a new file (anything else opens an existing one)
+ * @throws DbException if the file doesn't exist (or does when creating)
+ */
+void MmapFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    if (flags) {
+        this->fd = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (this->fd < 0)
+            throw DbException(("cannot create " + this->path).c_str(), errno);
+    } else {
+        this->fd = ::open(this->path.c_str(), O_RDWR);
+        if (this->fd < 0)
+            throw DbException(("cannot open " + this->path).c_str(), errno);
+        Header header;
+        if (pread(this->fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) || header.magic != MAGIC
+            || !DbBlock::valid_block_size(header.block_size) || header.overflow_last == 0) {
+            ::close(this->fd);
+            throw DbRelationError(this->dbfilename + " is not a heap file");
+        }
+        this->block_size = header.block_size;
+    }
+
+    void *reserved = mmap(nullptr, RESERVE_SZ, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        ::close(this->fd);
+        throw DbRelationError("cannot reserve memory to map " + this->dbfilename);
+    }
+    this->base = (char *) reserved;
+    this->mapped = 0;
+    this->fsm.set_heap_block_size(this->block_size);
+    this->overflow.set_block_size(this->block_size);
+
+    if (flags) {
+        grow(this->block_size);
+        this->last = 0;
+        this->row_count = 0;
+        this->free_bytes = 0;
+        this->schema_version = 0;
+        write_header();
+    } else {
+        struct stat st;
+        fstat(this->fd, &st);
+        grow((size_t) st.st_size);
+        read_header();
+    }
+    this->closed = false;
+    if (!flags) {
+        this->fsm.open();
+        this->overflow.open();
+    }
+}
+
+/**
+ * Take our fields from the header at the start of the mapping.
+ */
+void MmapFile::read_header() {
+    Header header;
+    memcpy(&header, this->base, sizeof(header));
+    set_header(header);
+}
+
+/**
+ * Update the header at the start of the mapping.
+ */
+void MmapFile::write_header() {
+    Header header = get_header();
+    header.magic = MAGIC;
+    memcpy(this->base, &header, sizeof(header));
+}
+
+/**
+ * Make sure the file and its mapping cover at least the given number of bytes. The new part
+ * of the file is mapped just after the old, so addresses already handed out stay good.
+ * @param size  bytes needed
+ */
+void MmapFile::grow(size_t size) {
+    if (size <= this->mapped)
+        return;
+    size_t chunk = (size_t) GROW_BLOCKS * this->block_size;
+    size = (size + chunk - 1) / chunk * chunk;
+    if (size > RESERVE_SZ)
+        throw DbRelationError(this->dbfilename + " is too big to map");
+    struct stat st;
+    if (fstat(this->fd, &st) != 0 || ((size_t) st.st_size < size && ftruncate(this->fd, size) != 0))
+        throw DbRelationError("cannot extend " + this->dbfilename);
+    void *more = mmap(this->base + this->mapped, size - this->mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                      this->fd, this->mapped);
+    if (more == MAP_FAILED)
+        throw DbRelationError("cannot map " + this->dbfilename);
+    this->mapped = size;
+}
+
+/**
+ * Give back the whole reserved address range.
+ */
+void MmapFile::unmap() {
+    munmap(this->base, RESERVE_SZ);
+    this->base = nullptr;
+    this->mapped = 0;
+}
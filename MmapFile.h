@@ -0,0 +1,86 @@
+/**
+ * @file MmapFile.h - Implementation of storage_engine with a memory-mapped heap file.
+ * MmapFile: HeapFile
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include "HeapFile.h"
+
+/**
+ * @class MmapFile - heap file kept in a plain file that is mapped into memory
+ *
+ * Same block layout and side files (free-space map, overflow) as HeapFile, but instead of a
+ * Berkeley DB RecNo file copied in and out of the buffer pool, the blocks are in a plain file,
+ * <name>.mmap in the database environment's home directory, mapped into our address space.
+ * get() returns a SlottedPage over the mapped bytes themselves, so reading a block is no more
+ * than touching its memory, and changes go straight to the page cache; the operating system
+ * writes them back (close forces that with msync).
+ *
+ * Block n is at offset n * block_size. Block 0 is the header (HeapFile::Header, with our own
+ * magic number), so the blocks are numbered from 1. A large range of addresses is reserved
+ * up front and the file is mapped into the start of it, growing in place, so a page handed
+ * out stays valid as the file gets bigger.
+ */
+class MmapFile : public HeapFile {
+public:
+    /**
+     * Identifies one of our files (first 4 bytes of the header)
+     */
+    static const uint32_t MAGIC = 0x4D4D4150;
+
+    /**
+     * Number of blocks the file grows by at a time
+     */
+    static const uint GROW_BLOCKS = 64;
+
+    /**
+     * Bytes of address space reserved for the mapping (bounds the size of the file)
+     */
+    static const size_t RESERVE_SZ = (size_t) 1 << 36;
+
+    MmapFile(std::string name, uint block_size = DbBlock::BLOCK_SZ);
+
+    virtual ~MmapFile();
+
+    MmapFile(const MmapFile &other) = delete;
+
+    MmapFile(MmapFile &&temp) = delete;
+
+    MmapFile &operator=(const MmapFile &other) = delete;
+
+    MmapFile &operator=(MmapFile &&temp) = delete;
+
+    virtual void drop(void);
+
+    virtual void close(void);
+
+    virtual void flush(void);
+
+    virtual SlottedPage *get_new(void);
+
+    virtual SlottedPage *get(BlockID block_id);
+
+    virtual void put(DbBlock *block);
+
+    virtual void prefetch(BlockID first, uint count);
+
+    virtual bool in_use() const;
+
+protected:
+    std::string path;
+    int fd;
+    char *base;         // start of the reserved address range, with the file mapped at the front
+    size_t mapped;      // bytes of the file currently mapped
+
+    virtual void db_open(uint flags = 0);
+
+    virtual void read_header();
+
+    virtual void write_header();
+
+    virtual void grow(size_t size);
+
+    virtual void unmap();
+};
@@ -0,0 +1,218 @@
+/**
+ * @file OverflowFile.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "OverflowFile.h"
+
+using namespace std;
+
+/**
+ * Constructor
+ * @param name  name of the heap file this is for
+ */
+OverflowFile::OverflowFile(string name) : dbfilename(name + ".ovf.db"), closed(true), db(nullptr),
+                                          pool(BufferPool::get_pool()), block_size(DbBlock::BLOCK_SZ), last(0),
+                                          free_head(0) {
+}
+
+/**
+ * Destructor - make sure the buffer pool doesn't hold on to any of our pages.
+ */
+OverflowFile::~OverflowFile() {
+    if (!this->closed)
+        this->pool.flush(this);
+    this->pool.discard(this);
+    db_close();
+}
+
+/**
+ * Create the physical file with just its reserved first page.
+ */
+void OverflowFile::create(void) {
+    db_open(DB_CREATE | DB_EXCL);
+    this->last = 1;
+    this->free_head = 0;
+    BufferFrame *frame = this->pool.pin(this, 1, true);
+    memset(frame->data, 0, this->block_size);
+    write_block(1, frame->data);
+    this->pool.unpin(frame);
+}
+
+/**
+ * Remove the physical file.
+ */
+void OverflowFile::drop(void) {
+    this->pool.discard(this);
+    close();
+    Db db(_DB_ENV, 0);
+    db.remove(this->dbfilename.c_str(), nullptr, 0);
+}
+
+/**
+ * Open the physical file.
+ * @throws DbException if it doesn't exist
+ */
+void OverflowFile::open(void) {
+    db_open();
+}
+
+/**
+ * Write back our dirty pages, leaving the file open.
+ */
+void OverflowFile::flush(void) {
+    if (!this->closed)
+        this->pool.flush(this);
+}
+
+/**
+ * Write back our dirty pages and close the physical file.
+ */
+void OverflowFile::close(void) {
+    if (this->closed)
+        return;
+    this->pool.flush(this);
+    this->pool.discard(this);
+    db_close();
+    this->closed = true;
+}
+
+/**
+ * Store a value in a new chain of pages. Each page is written as soon as it is filled in
+ * (with its next pointer already known), so Berkeley DB always knows about every page.
+ * @param data  the value's bytes
+ * @param size  how many of them
+ * @return      id of the first page
+ */
+BlockID OverflowFile::write(const char *data, uint32_t size) {
+    lock_guard<mutex> lock(this->latch);
+    uint capacity = this->block_size - PAGE_HEADER_SZ;
+    uint num_pages = max((size + capacity - 1) / capacity, 1U);
+    BlockIDs chain;
+    for (uint i = 0; i < num_pages; i++)
+        chain.push_back(allocate());
+    uint32_t offset = 0;
+    for (uint i = 0; i < num_pages; i++) {
+        BufferFrame *frame = this->pool.pin(this, chain[i], true);
+        memset(frame->data, 0, PAGE_HEADER_SZ);
+        *(uint32_t *) frame->data = i + 1 < num_pages ? chain[i + 1] : 0;
+        uint chunk = min(size - offset, capacity);
+        memcpy(frame->data + PAGE_HEADER_SZ, data + offset, chunk);
+        memset(frame->data + PAGE_HEADER_SZ + chunk, 0, capacity - chunk);
+        offset += chunk;
+        write_block(chain[i], frame->data);
+        this->pool.unpin(frame);
+    }
+    return chain[0];
+}
+
+/**
+ * Fetch a value by following its chain.
+ * @param first  id of the first page
+ * @param size   the value's length
+ * @param value  set to the value
+ */
+void OverflowFile::read(BlockID first, uint32_t size, string &value) {
+    uint capacity = this->block_size - PAGE_HEADER_SZ;
+    value.resize(size);
+    uint32_t offset = 0;
+    BlockID block_id = first;
+    while (offset < size && block_id != 0) {
+        BufferFrame *frame = this->pool.pin(this, block_id);
+        uint chunk = min(size - offset, capacity);
+        memcpy(&value[offset], frame->data + PAGE_HEADER_SZ, chunk);
+        offset += chunk;
+        block_id = *(uint32_t *) frame->data;
+        this->pool.unpin(frame);
+    }
+}
+
+/**
+ * Put a chain's pages on the free list.
+ * @param first  id of the first page of the chain
+ */
+void OverflowFile::free(BlockID first) {
+    lock_guard<mutex> lock(this->latch);
+    BlockID block_id = first;
+    while (true) {
+        BufferFrame *frame = this->pool.pin(this, block_id);
+        BlockID next = *(uint32_t *) frame->data;
+        if (next == 0) {
+            *(uint32_t *) frame->data = this->free_head;  // splice the whole chain onto the list
+            this->pool.mark_dirty(frame);
+            this->pool.unpin(frame);
+            break;
+        }
+        this->pool.unpin(frame);
+        block_id = next;
+    }
+    this->free_head = first;
+}
+
+/**
+ * Find a page for a new chain: a freed one if there are any, otherwise a new one at the end.
+ * @return  page id
+ */
+BlockID OverflowFile::allocate() {
+    if (this->free_head == 0)
+        return ++this->last;
+    BlockID block_id = this->free_head;
+    BufferFrame *frame = this->pool.pin(this, block_id);
+    BlockID next = *(uint32_t *) frame->data;
+    this->pool.unpin(frame);
+    this->free_head = next;
+    return block_id;
+}
+
+/**
+ * Read a page from Berkeley DB into the given memory.
+ * @param block_id  which page
+ * @param data      where to put it
+ */
+void OverflowFile::read_block(BlockID block_id, void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt(data, this->block_size);
+    dbt.set_ulen(this->block_size);
+    dbt.set_flags(DB_DBT_USERMEM);
+    this->db->get(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Write a page to Berkeley DB.
+ * @param block_id  which page
+ * @param data      the page's bytes
+ */
+void OverflowFile::write_block(BlockID block_id, const void *data) {
+    Dbt key(&block_id, sizeof(block_id));
+    Dbt dbt((void *) data, this->block_size);
+    this->db->put(nullptr, &key, &dbt, 0);
+}
+
+/**
+ * Wrapper for Berkeley DB open, which does both open and creation.
+ * @param flags BerkDb flags
+ */
+void OverflowFile::db_open(uint flags) {
+    if (!this->closed)
+        return;
+    this->db = new Db(_DB_ENV, 0);
+    this->db->set_re_len(this->block_size);
+    try {
+        this->db->open(nullptr, this->dbfilename.c_str(), nullptr, DB_RECNO, flags | DB_THREAD, 0644);
+    } catch (DbException &e) {
+        db_close();
+        throw;
+    }
+    this->closed = false;
+}
+
+/**
+ * Close and let go of the Berkeley DB handle, if we have one.
+ */
+void OverflowFile::db_close() {
+    if (this->db == nullptr)
+        return;
+    this->db->close(0);
+    delete this->db;
+    this->db = nullptr;
+}
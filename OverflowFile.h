@@ -0,0 +1,140 @@
+/**
+ * @file OverflowFile.h - Out-of-line storage for TEXT values too big to keep in a heap block.
+ * OverflowFile: BufferedFile
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "db_cxx.h"
+#include "BufferPool.h"
+
+/**
+ * @class OverflowFile - chains of pages holding big values for the records of one HeapFile
+ *
+ * A big value is split across a chain of pages in a Berkeley DB RecNo file of its own next to
+ * the heap file (with the same block size), so the heap blocks hold only a small pointer to it
+ * and stay dense. Each page starts with the id of the next page in the chain (0 at the end),
+ * followed by 4 reserved bytes and then the data. Block 1 is reserved. Freed pages go on a
+ * list and are reused before the file is extended. The number of pages and the head of that
+ * list are kept in the heap file's header (see set_pages), so opening the file reads nothing.
+ *
+ * In a marshalled record, an out-of-line TEXT value has TEXT_MARKER in place of its length,
+ * followed by the value's length and the id of the first page of its chain (4 bytes each).
+ * Writing and freeing chains are latched, so threads inserting into the same table can share
+ * the file.
+ */
+class OverflowFile : public BufferedFile {
+public:
+    /**
+     * Stored in place of a TEXT length to say the value is out of line (no block is that big)
+     */
+    static const uint16_t TEXT_MARKER = 0xFFFF;
+
+    /**
+     * Bytes following TEXT_MARKER in a marshalled record: length and first page
+     */
+    static const uint POINTER_SZ = 2 * sizeof(uint32_t);
+
+    /**
+     * Bytes at the start of each page before its data
+     */
+    static const uint PAGE_HEADER_SZ = 8;
+
+    OverflowFile(std::string name);
+
+    virtual ~OverflowFile();
+
+    OverflowFile(const OverflowFile &other) = delete;
+
+    OverflowFile(OverflowFile &&temp) = delete;
+
+    OverflowFile &operator=(const OverflowFile &other) = delete;
+
+    OverflowFile &operator=(OverflowFile &&temp) = delete;
+
+    virtual void create(void);
+
+    virtual void drop(void);
+
+    virtual void open(void);
+
+    virtual void close(void);
+
+    virtual void flush(void);
+
+    /**
+     * Set the size of our pages (the heap file's block size), before create or open.
+     * @param block_size  bytes per page
+     */
+    virtual void set_block_size(uint block_size) { this->block_size = block_size; }
+
+    virtual uint get_block_size() const { return block_size; }
+
+    /**
+     * Tell the file where its pages end and its free list starts (kept in the heap file's
+     * header), before open.
+     * @param last       id of the final page
+     * @param free_head  first page of the free list (0 for none)
+     */
+    virtual void set_pages(BlockID last, BlockID free_head) {
+        this->last = last;
+        this->free_head = free_head;
+    }
+
+    /**
+     * Where the pages end and the free list starts, for the heap file's header.
+     * @param last       set to the id of the final page
+     * @param free_head  set to the first page of the free list (0 for none)
+     */
+    virtual void get_pages(BlockID &last, BlockID &free_head) const {
+        std::lock_guard<std::mutex> lock(this->latch);
+        last = this->last;
+        free_head = this->free_head;
+    }
+
+    /**
+     * Store a value in a new chain of pages.
+     * @param data  the value's bytes
+     * @param size  how many of them
+     * @returns     id of the first page of the chain
+     */
+    virtual BlockID write(const char *data, uint32_t size);
+
+    /**
+     * Fetch a value stored by write().
+     * @param first  id of the first page of its chain
+     * @param size   the value's length
+     * @param value  set to the value
+     */
+    virtual void read(BlockID first, uint32_t size, std::string &value);
+
+    /**
+     * Give the pages of a chain back for reuse.
+     * @param first  id of the first page of the chain
+     */
+    virtual void free(BlockID first);
+
+protected:
+    std::string dbfilename;
+    bool closed;
+    Db *db;  // opened in db_open
+    BufferPool &pool;
+    uint block_size;
+    BlockID last;
+    BlockID free_head;  // first page of the list of freed pages (0 for none)
+    mutable std::mutex latch;  // held while the page list is changed (write and free)
+
+    virtual BlockID allocate();
+
+    virtual void read_block(BlockID block_id, void *data);
+
+    virtual void write_block(BlockID block_id, const void *data);
+
+    virtual void db_open(uint flags = 0);
+
+    virtual void db_close();
+};
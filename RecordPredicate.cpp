@@ -0,0 +1,138 @@
+/**
+ * @file RecordPredicate.cpp
+ * @see Seattle University, CPSC5300
+ */
+#include <cstring>
+#include "RecordPredicate.h"
+
+using namespace std;
+typedef uint16_t u16;
+
+/**
+ * Constructor
+ * @param column_attributes  the table's columns, in order
+ * @param overflow           where the table's out-of-line values are stored
+ */
+RecordPredicate::RecordPredicate(const ColumnAttributes &column_attributes, OverflowFile *overflow)
+        : data_types(), terms(), unsatisfiable(false), overflow(overflow), out_of_line() {
+    for (auto ca: column_attributes)
+        this->data_types.push_back(ca.get_data_type());
+}
+
+/**
+ * Add a condition on one column.
+ * @param ordinal  which column of the table
+ * @param op       comparison
+ * @param value    constant to compare the column to
+ */
+void RecordPredicate::add(uint ordinal, Op op, const Value &value) {
+    if (ordinal >= this->data_types.size())
+        throw DbRelationError("no such column in predicate");
+    if (this->data_types[ordinal] == ColumnAttribute::BOOLEAN && op != EQ && op != NE)
+        throw DbRelationError("can only compare BOOLEAN columns for equality");
+    if (value.data_type != this->data_types[ordinal]) {
+        this->unsatisfiable = true;  // same as Value::operator== across types
+        return;
+    }
+    Term term = {ordinal, op, value};
+    auto it = this->terms.begin();
+    while (it != this->terms.end() && it->ordinal <= ordinal)
+        it++;
+    this->terms.insert(it, term);
+}
+
+/**
+ * Evaluate the conditions against a marshalled record.
+ * @param record  the record's bytes
+ * @return        true if it satisfies all the conditions
+ */
+bool RecordPredicate::matches(const RecordView &record) const {
+    if (this->unsatisfiable)
+        return false;
+    const char *bytes = record.data;
+    uint offset = 0;
+    uint col_num = 0;
+    for (auto const &term: this->terms) {
+        for (; col_num < term.ordinal; col_num++)
+            offset += field_size(bytes + offset, this->data_types[col_num]);
+        const char *field = bytes + offset;
+        int comparison;
+        if (term.value.data_type == ColumnAttribute::TEXT) {
+            uint size = *(u16 *) field;
+            const char *text = field + sizeof(u16);
+            uint other = (uint) term.value.s.size();
+            bool in_overflow = size == OverflowFile::TEXT_MARKER;
+            if (in_overflow)
+                size = *(uint32_t *) text;
+            if ((term.op == EQ || term.op == NE) && size != other) {
+                comparison = 1;  // no need to look at the text, least of all fetch it from the overflow file
+            } else {
+                if (in_overflow) {
+                    if (this->overflow == nullptr)
+                        throw DbRelationError("out-of-line value without an overflow file");
+                    this->overflow->read(*(uint32_t *) (text + sizeof(uint32_t)), size, this->out_of_line);
+                    text = this->out_of_line.data();
+                }
+                comparison = memcmp(text, term.value.s.data(), min(size, other));
+                if (comparison == 0)
+                    comparison = size < other ? -1 : (size > other ? 1 : 0);
+            }
+        } else {
+            int32_t n;
+            if (term.value.data_type == ColumnAttribute::INT)
+                n = *(int32_t *) field;
+            else
+                n = *(uint8_t *) field;
+            comparison = n < term.value.n ? -1 : (n > term.value.n ? 1 : 0);
+        }
+        if (!test(comparison, term.op))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Size of a marshalled field.
+ * @param bytes      start of the field
+ * @param data_type  its type
+ * @return           number of bytes it occupies
+ */
+uint RecordPredicate::field_size(const char *bytes, ColumnAttribute::DataType data_type) {
+    switch (data_type) {
+        case ColumnAttribute::INT:
+            return sizeof(int32_t);
+        case ColumnAttribute::TEXT:
+            if (*(u16 *) bytes == OverflowFile::TEXT_MARKER)
+                return sizeof(u16) + OverflowFile::POINTER_SZ;
+            return sizeof(u16) + *(u16 *) bytes;
+        case ColumnAttribute::BOOLEAN:
+            return sizeof(uint8_t);
+        default:
+            throw DbRelationError("Only know how to unmarshal INT, TEXT, and BOOLEAN");
+    }
+}
+
+/**
+ * Apply a comparison operator to the result of a three-way compare.
+ * @param comparison  negative, zero or positive as the field is less than, equal to or greater than the constant
+ * @param op          operator
+ * @return            whether the condition holds
+ */
+bool RecordPredicate::test(int comparison, Op op) {
+    switch (op) {
+        case EQ:
+            return comparison == 0;
+        case NE:
+            return comparison != 0;
+        case LT:
+            return comparison < 0;
+        case LE:
+            return comparison <= 0;
+        case GT:
+            return comparison > 0;
+        case GE:
+            return comparison >= 0;
+        default:
+            return false;
+    }
+}
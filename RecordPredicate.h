@@ -0,0 +1,73 @@
+/**
+ * @file RecordPredicate.h - Where-clause compiled against a table's record layout.
+ * RecordPredicate
+ *
+ * @see "Seattle University, CPSC5300, Spring 2020"
+ */
+#pragma once
+
+#include <vector>
+#include "storage_engine.h"
+#include "OverflowFile.h"
+
+/**
+ * @class RecordPredicate - conditions evaluated directly on marshalled record bytes
+ *
+ * Built once per scan from the table's column attributes and the where clause, then
+ * applied to the bytes of each record as they sit in the block (see HeapTable::marshal for
+ * the layout). Only the columns up to the last one tested are stepped over, and no Value
+ * objects are built, so a row that fails costs a few compares. An out-of-line TEXT value is
+ * only fetched if there is a condition on its column.
+ */
+class RecordPredicate {
+public:
+    /**
+     * Comparison of a column to a constant.
+     */
+    enum Op {
+        EQ, NE, LT, LE, GT, GE
+    };
+
+    RecordPredicate(const ColumnAttributes &column_attributes, OverflowFile *overflow = nullptr);
+
+    virtual ~RecordPredicate() {}
+
+    /**
+     * Add a condition; a record must satisfy all of them.
+     * @param ordinal  which column of the table
+     * @param op       comparison
+     * @param value    constant to compare the column to (a value of the wrong type matches nothing)
+     * @throws         DbRelationError if the column doesn't exist or can't be compared with op
+     */
+    virtual void add(uint ordinal, Op op, const Value &value);
+
+    /**
+     * Check whether there are any conditions at all.
+     * @returns  true if every record matches
+     */
+    virtual bool empty() const { return terms.empty() && !unsatisfiable; }
+
+    /**
+     * Evaluate the conditions against a marshalled record.
+     * @param record  the record, as returned by SlottedPage::view
+     * @returns       true if it satisfies all the conditions
+     */
+    virtual bool matches(const RecordView &record) const;
+
+protected:
+    struct Term {
+        uint ordinal;
+        Op op;
+        Value value;
+    };
+
+    std::vector<ColumnAttribute::DataType> data_types;
+    std::vector<Term> terms;  // kept in column order so one pass over the record does
+    bool unsatisfiable;       // some condition can never be met
+    OverflowFile *overflow;   // where out-of-line values are
+    mutable std::string out_of_line;  // the last out-of-line value fetched
+
+    static uint field_size(const char *bytes, ColumnAttribute::DataType data_type);
+
+    static bool test(int comparison, Op op);
+};
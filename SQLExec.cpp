@@ -3,6 +3,8 @@
  * @author Kevin Lundeen
  * @see "Seattle University, CPSC5300, Spring 2020"
  */
+#include <algorithm>
+#include <iostream>
 #include "SQLExec.h"
 
 using namespace std;
@@ -22,8 +24,8 @@ ostream &operator<<(ostream &out, const QueryResult &qres) {
             out << "----------+";
         out << endl;
         for (auto const &row: *qres.rows) {
-            for (auto const &column_name: *qres.column_names) {
-                Value value = row->at(column_name);
+            for (uint i = 0; i < row->size(); i++) {
+                const Value &value = (*row)[i];
                 switch (value.data_type) {
                     case ColumnAttribute::INT:
                         out << value.n;
@@ -60,24 +62,39 @@ QueryResult::~QueryResult() {
 
 
 QueryResult *SQLExec::execute(const SQLStatement *statement) {
-    // initialize _tables table, if not yet present
+    // initialize _tables and _indices tables, if not yet present
     if (SQLExec::tables == nullptr)
         SQLExec::tables = new Tables();
+    if (SQLExec::indices == nullptr)
+        SQLExec::indices = new Indices();
 
+    QueryResult *result = nullptr;  // deleted again if the flush at the end fails
     try {
         switch (statement->type()) {
             case kStmtCreate:
-                return create((const CreateStatement *) statement);
+                result = create((const CreateStatement *) statement);
+                break;
             case kStmtDrop:
-                return drop((const DropStatement *) statement);
+                result = drop((const DropStatement *) statement);
+                break;
             case kStmtShow:
-                return show((const ShowStatement *) statement);
+                result = show((const ShowStatement *) statement);
+                break;
             default:
                 return new QueryResult("not implemented");
         }
+        // every statement is its own transaction, so this is a commit boundary
+        Tables::flush_all();
+        SQLExec::indices->flush();
+        Indices::flush_all();
     } catch (DbRelationError &e) {
+        delete result;
         throw SQLExecError(string("DbRelationError: ") + e.what());
+    } catch (...) {
+        delete result;
+        throw;
     }
+    return result;
 }
 
 void SQLExec::column_definition(const ColumnDefinition *col, Identifier &column_name, ColumnAttribute &column_attribute) {
@@ -160,8 +177,6 @@ QueryResult *SQLExec::create_table(const CreateStatement *statement) {
 
 QueryResult *SQLExec::create_index(const CreateStatement *statement)
 {
-    SQLExec::indices = new Indices();
-
     ValueDict row;
 
     // Declare Identifier
@@ -169,12 +184,8 @@ QueryResult *SQLExec::create_index(const CreateStatement *statement)
     Identifier index_name = statement->indexName;
     Identifier index_type = statement->indexType;
 
-    bool is_unique = true;
-
-    if(index_type ==  "BTREE")
-        row["is_unique"] = true;
-    else
-        row["is_unique"] = false; // HASH
+    // the indices enforce is_unique, and CREATE INDEX has no way to ask for it, so no index is unique
+    bool is_unique = false;
 
     // get the table 
     DbRelation& table = SQLExec::tables->get_table(table_name);
@@ -206,8 +217,8 @@ QueryResult *SQLExec::create_index(const CreateStatement *statement)
             cHandles.push_back(indices->insert(&row));
         }
 
-            DbIndex& index = indices->get_index(table_name, index_name);
-            index.create();
+        DbIndex& index = indices->get_index(table_name, index_name);
+        index.create();
     }
     catch (...)
     {
@@ -341,19 +352,9 @@ QueryResult *SQLExec::show_index(const ShowStatement *statement)
     ValueDict where;
     where["table_name"] = Value(table_name);
 
-    Handles* handles = SQLExec::indices->select(&where);
-    ValueDicts* entries = new ValueDicts();
-
-    for(auto const& handle: *handles)
-    {
-        ValueDict* entry = SQLExec::indices->project(handle, column_names);
-        entries->push_back(entry);
-    }
+    Rows *entries = SQLExec::indices->scan(&where, column_names);
 
-    int size = handles->size();
-
-    // Delete handles when done
-    delete handles;
+    int size = entries->size();
 
     return new QueryResult(column_names, column_attributes, entries, " successfully returned " + to_string(size) + " rows!");
 }
@@ -365,19 +366,18 @@ QueryResult *SQLExec::show_tables() {
     ColumnAttributes *column_attributes = new ColumnAttributes;
     column_attributes->push_back(ColumnAttribute(ColumnAttribute::TEXT));
 
-    Handles *handles = SQLExec::tables->select();
-    u_long n = handles->size() - 3;
+    Rows *all_rows = SQLExec::tables->scan(nullptr, column_names);
+    u_long n = all_rows->size() - 3;
 
-    ValueDicts *rows = new ValueDicts;
-    for (auto const &handle: *handles) {
-        ValueDict *row = SQLExec::tables->project(handle, column_names);
+    Rows *rows = new Rows;
+    for (auto const &row: *all_rows) {
         Identifier table_name = row->at("table_name").s;
         if (table_name != Tables::TABLE_NAME && table_name != Columns::TABLE_NAME && table_name != Indices::TABLE_NAME)
             rows->push_back(row);
         else
             delete row;
     }
-    delete handles;
+    delete all_rows;
     return new QueryResult(column_names, column_attributes, rows, "successfully returned " + to_string(n) + " rows");
 }
 
@@ -394,14 +394,92 @@ QueryResult *SQLExec::show_columns(const ShowStatement *statement) {
 
     ValueDict where;
     where["table_name"] = Value(statement->tableName);
-    Handles *handles = columns.select(&where);
-    u_long n = handles->size();
+    Rows *rows = columns.scan(&where, column_names);
+    u_long n = rows->size();
 
-    ValueDicts *rows = new ValueDicts;
-    for (auto const &handle: *handles) {
-        ValueDict *row = columns.project(handle, column_names);
-        rows->push_back(row);
-    }
-    delete handles;
     return new QueryResult(column_names, column_attributes, rows, "successfully returned " + to_string(n) + " rows");
 }
+
+/**
+ * Parse and execute one SQL statement.
+ * @param sql  the statement
+ * @returns    its result (freed by caller)
+ */
+static QueryResult *execute_sql(const string &sql) {
+    SQLParserResult *parse = SQLParser::parseSQLString(sql);
+    try {
+        if (!parse->isValid() || parse->size() != 1)
+            throw SQLExecError("invalid SQL: " + sql);
+        QueryResult *result = SQLExec::execute(parse->getStatement(0));
+        delete parse;
+        return result;
+    } catch (...) {
+        delete parse;
+        throw;
+    }
+}
+
+/**
+ * Test that indices go on columns with duplicate values and keep taking them.
+ * @returns true if the tests all succeeded
+ */
+bool test_sql_exec() {
+    delete execute_sql("create table _test_dups (a int, b text)");
+    bool ok = true;
+    try {
+        DbRelation &table = Tables::get_table("_test_dups");
+        ValueDict row;
+        for (int i = 0; i < 10; i++) {
+            row["a"] = Value(i % 3);
+            row["b"] = Value("b" + to_string(i % 2));
+            table.insert(&row);
+        }
+        delete execute_sql("create index _test_fa on _test_dups using BTREE (a)");
+        delete execute_sql("create index _test_hb on _test_dups using HASH (b)");
+        table.insert(&row);  // a key both indices already have
+        QueryResult *result = execute_sql("show index from _test_dups");
+        const ColumnNames &column_names = *result->get_column_names();
+        uint is_unique = (uint) (find(column_names.begin(), column_names.end(), "is_unique") - column_names.begin());
+        ok = result->get_rows()->size() == 2;
+        for (auto const &index_row: *result->get_rows())
+            ok = ok && (*index_row)[is_unique].n == 0;
+        delete result;
+        Handles *handles = table.select();
+        ok = ok && handles->size() == 11;
+        delete handles;
+        if (ok)
+            cout << "create index on duplicate values ok" << endl;
+
+        // as if in a new process: no objects yet for the table or its indices
+        auto forget = [](const Identifier &table_name) {
+            for (auto entry = Indices::index_cache.begin(); entry != Indices::index_cache.end();) {
+                if (entry->first.first == table_name) {
+                    delete entry->second;
+                    entry = Indices::index_cache.erase(entry);
+                } else {
+                    entry++;
+                }
+            }
+            delete Tables::table_cache.at(table_name);
+            Tables::table_cache.erase(table_name);
+        };
+        forget("_test_dups");
+        Tables::indices_table->get_index("_test_dups", "_test_fa");
+        ok = ok && dynamic_cast<HeapTable &>(Tables::get_table("_test_dups")).get_index_count() == 2;
+        forget("_test_dups");
+        delete execute_sql("drop index _test_fa from _test_dups");
+        HeapTable &reloaded = dynamic_cast<HeapTable &>(Tables::get_table("_test_dups"));
+        ok = ok && reloaded.get_index_count() == 1;
+        reloaded.insert(&row);
+        handles = reloaded.select();
+        ok = ok && handles->size() == 12;
+        delete handles;
+        if (ok)
+            cout << "indices attached once ok" << endl;
+    } catch (exception &e) {
+        cout << e.what() << endl;
+        ok = false;
+    }
+    delete execute_sql("drop table _test_dups");
+    return ok;
+}
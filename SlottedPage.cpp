@@ -5,6 +5,7 @@
  */
 #include <cstring>
 #include "SlottedPage.h"
+#include "BufferPool.h"
 
 using namespace std;
 typedef uint16_t u16;
@@ -14,32 +15,86 @@ typedef uint16_t u16;
  * @param block
  * @param block_id
  * @param is_new
+ * @param frame     buffer pool frame holding the block's memory, if any (this page takes over the caller's pin)
  */
-SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new) : DbBlock(block, block_id, is_new) {
+SlottedPage::SlottedPage(Dbt &block, BlockID block_id, bool is_new, BufferFrame *frame) : DbBlock(block, block_id,
+                                                                                                  is_new),
+                                                                                          frame(frame), live_bytes(-1) {
     if (is_new) {
         this->num_records = 0;
-        this->end_free = DbBlock::BLOCK_SZ - 1;
+        this->end_free = (u16) (get_block_size() - 1);
+        this->free_slot = 0;
+        this->live_bytes = 0;
         put_header();
+        put_n(6, 0);  // reserved
     } else {
         get_header(this->num_records, this->end_free);
+        this->free_slot = get_n(4);
     }
 }
 
 /**
- * Add a new record to the block.
+ * Destructor - releases the buffer frame pin, if any.
+ */
+SlottedPage::~SlottedPage() {
+    if (this->frame != nullptr)
+        this->frame->pool->unpin(this->frame);
+}
+
+/**
+ * Copy constructor - the copy refers to the same memory, so it takes its own pin on the frame.
+ * @param other
+ */
+SlottedPage::SlottedPage(const SlottedPage &other) : DbBlock(other), num_records(other.num_records),
+                                                     end_free(other.end_free), free_slot(other.free_slot), frame(other.frame),
+                                                     live_bytes(other.live_bytes) {
+    if (this->frame != nullptr)
+        this->frame->pool->pin(this->frame);
+}
+
+/**
+ * Copy assignment - swap our pin for one on the other page's frame.
+ * @param other
+ * @return this
+ */
+SlottedPage &SlottedPage::operator=(const SlottedPage &other) {
+    if (other.frame != nullptr)
+        other.frame->pool->pin(other.frame);
+    if (this->frame != nullptr)
+        this->frame->pool->unpin(this->frame);
+    DbBlock::operator=(other);
+    this->num_records = other.num_records;
+    this->end_free = other.end_free;
+    this->free_slot = other.free_slot;
+    this->frame = other.frame;
+    this->live_bytes = other.live_bytes;
+    return *this;
+}
+
+/**
+ * Add a new record to the block. Reuses the id of a deleted record if there is one, so the
+ * header array only grows when every slot is in use.
  * @param data
  * @return the new block's id
  */
 RecordID SlottedPage::add(const Dbt *data) {
-    if (!has_room((u16) data->get_size()))
-        throw DbBlockNoRoomError("not enough room for new record");
-    u16 id = ++this->num_records;
     u16 size = (u16) data->get_size();
-    this->end_free -= size;
-    u16 loc = this->end_free + 1U;
-    put_header();
+    u16 needed = size + (this->free_slot == 0 ? 4 : 0);  // room for a new header, too
+    if (!has_room(needed))
+        throw DbBlockNoRoomError("not enough room for new record");
+    if (!has_contiguous_room(needed))
+        compact();
+    u16 id;
+    if (this->free_slot != 0) {
+        id = this->free_slot;
+        u16 next, loc;
+        get_header(next, loc, id);
+        this->free_slot = next;
+    } else {
+        id = ++this->num_records;
+    }
+    u16 loc = append(data);
     put_header(id, size, loc);
-    memcpy(this->address(loc), data->get_data(), size);
     return id;
 }
 
@@ -56,6 +111,19 @@ Dbt *SlottedPage::get(RecordID record_id) const {
     return new Dbt(this->address(loc), size);
 }
 
+/**
+ * Look at a record in the block without copying it.
+ * @param record_id
+ * @return the record's bytes as they sit in the block (valid while this page is), data is nullptr if deleted
+ */
+RecordView SlottedPage::view(RecordID record_id) const {
+    u16 size, loc;
+    get_header(size, loc, record_id);
+    if (loc == 0)
+        return RecordView();  // this is just a tombstone, record has been deleted
+    return RecordView((const char *) this->address(loc), size);
+}
+
 /**
  * Replace the record with the given data.
  * @param record_id   record to replace
@@ -66,33 +134,43 @@ void SlottedPage::put(RecordID record_id, const Dbt &data) {
     u16 size, loc;
     get_header(size, loc, record_id);
     u16 new_size = (u16) data.get_size();
-    if (new_size > size) {
-        u16 extra = new_size - size;
-        if (!has_room(extra))
-            throw DbBlockNoRoomError("not enough room for enlarged record");
-        slide(loc, loc - extra);
-        memcpy(this->address(loc - extra), data.get_data(), new_size);
-    } else {
+    if (new_size <= size) {
+        // shrink in place; the tail end of the old record is left as a hole
         memcpy(this->address(loc), data.get_data(), new_size);
-        slide(loc + new_size, loc + size);
+        put_header(record_id, new_size, loc);
+        if (this->live_bytes >= 0)
+            this->live_bytes -= size - new_size;
+        return;
     }
-    get_header(size, loc, record_id);
+    if (!has_room(new_size - size))
+        throw DbBlockNoRoomError("not enough room for enlarged record");
+    // write the new version at the end of the free space; the old one becomes a hole
+    put_header(record_id, 0, 0);  // so compact() skips it
+    release(size, loc);
+    if (!has_contiguous_room(new_size))
+        compact();
+    loc = append(&data);
     put_header(record_id, new_size, loc);
 }
 
 /**
  * Delete a record from the page.
  *
- * Mark the given id as deleted by changing its size to zero and its location to 0.
- * Compact the rest of the data in the block. But keep the record ids the same for everyone.
+ * Mark the given id as deleted by changing its location to 0 and push it on the list of free
+ * slots (the size field of a tombstone holds the next free slot's id), so add() can hand the
+ * id out again. The record's bytes are left as a hole until add() or put() needs the room
+ * (see compact). Keep the record ids the same for everyone else.
  *
  * @param record_id  record to delete
  */
 void SlottedPage::del(RecordID record_id) {
     u16 size, loc;
     get_header(size, loc, record_id);
-    put_header(record_id, 0, 0);  // 0 is the tombstone sentinel
-    slide(loc, loc + size);
+    if (loc == 0)
+        return;  // already deleted
+    put_header(record_id, this->free_slot, 0);  // 0 location is the tombstone sentinel
+    this->free_slot = (u16) record_id;
+    release(size, loc);
 }
 
 /**
@@ -101,24 +179,46 @@ void SlottedPage::del(RecordID record_id) {
  */
 RecordIDs *SlottedPage::ids(void) const {
     RecordIDs *vec = new RecordIDs();
+    for (RecordID record_id: *this)
+        vec->push_back(record_id);
+    return vec;
+}
+
+/**
+ * Next non-deleted record ID after the given one.
+ * @param record_id  previous id, or 0 to start at the beginning
+ * @return           following id, or 0 if there are no more
+ */
+RecordID SlottedPage::next_id(RecordID record_id) const {
     u16 size, loc;
-    for (RecordID record_id = 1; record_id <= this->num_records; record_id++) {
-        get_header(size, loc, record_id);
+    while (record_id < this->num_records) {
+        get_header(size, loc, ++record_id);
         if (loc != 0)
-            vec->push_back(record_id);
+            return record_id;
     }
-    return vec;
+    return 0;
+}
+
+/**
+ * How big a record could be added to this block right now.
+ * @return  bytes available for a new record (after allowing for its header)
+ */
+u16 SlottedPage::free_space() const {
+    int room = (int) this->end_free + 1 + hole_bytes() - headers_end() - (this->free_slot == 0 ? 4 : 0);
+    return room > 0 ? (u16) room : 0;
 }
 
 /**
- * Get the size and offset for given id. For id of zero, it is the block header.
+ * Get the size and offset for given id. For id of zero, it is the number of records and the
+ * end of free space from the block header.
  * @param size  set to the size from given header
  * @param loc   set to the byte offset from given header
  * @param id    the id of the header to fetch
  */
 void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const {
-    size = get_n((u16) 4 * id);
-    loc = get_n((u16) (4 * id + 2));
+    u16 offset = id == 0 ? 0 : (u16) (4 * id + 4);
+    size = get_n(offset);
+    loc = get_n((u16) (offset + 2));
 }
 
 /**
@@ -129,58 +229,114 @@ void SlottedPage::get_header(u_int16_t &size, u_int16_t &loc, RecordID id) const
  */
 void SlottedPage::put_header(RecordID id, u16 size, u16 loc) {
     if (id == 0) { // called the put_header() version and using the default params
-        size = this->num_records;
-        loc = this->end_free;
+        put_n(0, this->num_records);
+        put_n(2, this->end_free);
+        put_n(4, this->free_slot);
+        return;
     }
-    put_n((u16) 4 * id, size);
-    put_n((u16) (4 * id + 2), loc);
+    put_n((u16) (4 * id + 4), size);
+    put_n((u16) (4 * id + 6), loc);
+}
+
+/**
+ * Offset just past the last record header.
+ * @return  bytes used by the block header and the record headers
+ */
+u16 SlottedPage::headers_end() const {
+    return (u16) (8 + 4 * this->num_records);
 }
 
 /**
- * Calculate if we have room to store a record with given size. The size should include the 4 bytes
- * for the header, too, if this is an add.
- * @param size   size of the new record (not including the header space needed)
+ * Calculate if we have room to store a record with given size, once any holes are compacted
+ * away. The size should include the 4 bytes for the header, too, if this is an add that needs
+ * a new slot.
+ * @param size   bytes needed
  * @return       true if there is enough room, false otherwise
  */
 bool SlottedPage::has_room(u16 size) const {
-    return 4 * (this->num_records + 1) + size <= this->end_free;
+    return has_contiguous_room(size) || headers_end() + size <= this->end_free + 1 + hole_bytes();
 }
 
 /**
- * Slide the contents to compensate for a smaller/larger record.
- *
- * If start < end, then remove data from offset start up to but not including offset end by sliding data
- * that is to the left of start to the right. If start > end, then make room for extra data from end to start
- * by sliding data that is to the left of start to the left.
- * Also fix up any record headers whose data has slid. Assumes there is enough room if it is a left
- * shift (end < start).
- *
- * @param start  beginning of slide
- * @param end    end of slide
+ * Calculate if the free space between the headers and the records can take the given number
+ * of bytes without compacting.
+ * @param size   bytes needed
+ * @return       true if there is enough room, false otherwise
  */
-void SlottedPage::slide(u_int16_t start, u_int16_t end) {
-    int shift = end - start;
-    if (shift == 0)
-        return;
+bool SlottedPage::has_contiguous_room(u16 size) const {
+    return headers_end() + size <= this->end_free + 1;
+}
+
+/**
+ * Number of bytes in the record area that no live record uses (left by del and put).
+ * Counts the live records the first time it is needed for this page object and keeps
+ * the count up to date after that.
+ * @return  bytes that compact() would reclaim
+ */
+int SlottedPage::hole_bytes() const {
+    if (this->live_bytes < 0) {
+        this->live_bytes = 0;
+        for (RecordID record_id: *this) {
+            u16 size, loc;
+            get_header(size, loc, record_id);
+            this->live_bytes += size;
+        }
+    }
+    return (int) get_block_size() - 1 - this->end_free - this->live_bytes;
+}
+
+/**
+ * Copy a record's bytes to the end of the free space (which must have room).
+ * @param data  the record
+ * @return      offset it was written at
+ */
+u16 SlottedPage::append(const Dbt *data) {
+    u16 size = (u16) data->get_size();
+    this->end_free -= size;
+    u16 loc = this->end_free + 1U;
+    put_header();
+    memcpy(this->address(loc), data->get_data(), size);
+    if (this->live_bytes >= 0)
+        this->live_bytes += size;
+    return loc;
+}
 
-    // slide data
-    void *to = this->address((u16) (this->end_free + 1 + shift));
-    void *from = this->address((u16) (this->end_free + 1));
-    int bytes = start - (this->end_free + 1U);
-    memmove(to, from, bytes);
+/**
+ * Give up a record's bytes (its header has already been changed). If they are right next to
+ * the free space they simply rejoin it, otherwise they are left as a hole for compact().
+ * @param size       its size
+ * @param loc        its offset
+ */
+void SlottedPage::release(u16 size, u16 loc) {
+    if (this->live_bytes >= 0)
+        this->live_bytes -= size;
+    if (loc == this->end_free + 1U) {
+        this->end_free += size;
+        put_header();
+    }
+}
 
-    // fix up headers to the right
-    RecordIDs *record_ids = ids();
-    for (auto const &record_id : *record_ids) {
+/**
+ * Squeeze out the holes so all the free space is between the headers and the records.
+ *
+ * The live records are packed toward the end of the block in header order, using a scratch
+ * copy of the record area so that records may be moved in any order. Each header is rewritten
+ * exactly once.
+ */
+void SlottedPage::compact() {
+    char scratch[DbBlock::MAX_BLOCK_SZ];
+    uint block_size = get_block_size();
+    uint end = block_size;
+    for (RecordID record_id: *this) {
         u16 size, loc;
         get_header(size, loc, record_id);
-        if (loc <= start) {
-            loc += shift;
-            put_header(record_id, size, loc);
-        }
+        end -= size;
+        memcpy(scratch + end, this->address(loc), size);
+        put_header(record_id, size, (u16) end);
     }
-    delete record_ids;
-    this->end_free += shift;
+    memcpy(this->address((u16) end), scratch + end, block_size - end);
+    this->live_bytes = (int) (block_size - end);
+    this->end_free = (u16) (end - 1);
     put_header();
 }
 
@@ -313,6 +469,34 @@ bool test_slotted_page() {
     if (get_dbt != nullptr)
         return assertion_failure("get of deleted record was not null");
 
+    // deleted space is reused once the page is compacted
+    char filler[1000];
+    memset(filler, 'x', sizeof(filler));
+    Dbt filler_dbt(filler, sizeof(filler));
+    RecordID first_filler = slot.add(&filler_dbt);
+    if (first_filler != 1)
+        return assertion_failure("add did not reuse deleted id", first_filler);
+    for (int i = 0; i < 3; i++)
+        slot.add(&filler_dbt);
+    slot.del(first_filler);
+    u16 room = slot.free_space();
+    if (room < sizeof(filler))
+        return assertion_failure("free space after del", room);
+    id = slot.add(&filler_dbt);
+    get_dbt = slot.get(2);
+    expected = string(rec2, sizeof(rec2));
+    actual = string((char *) get_dbt->get_data(), get_dbt->get_size());
+    delete get_dbt;
+    if (expected != actual)
+        return assertion_failure("get 2 back after compaction " + actual);
+    get_dbt = slot.get(id);
+    if (get_dbt->get_size() != sizeof(filler) || memcmp(get_dbt->get_data(), filler, sizeof(filler)) != 0)
+        return assertion_failure("get back record added by compaction", id);
+    delete get_dbt;
+    for (RecordID filler_id: slot)
+        if (filler_id != 2)
+            slot.del(filler_id);
+
     // try adding something too big
     rec2_dbt = Dbt(nullptr, DbBlock::BLOCK_SZ - 10); // too big, but only because we have a record in there
     try {
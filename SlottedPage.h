@@ -11,41 +11,77 @@
 
 #include "storage_engine.h"
 
+class BufferFrame;  // forward declare
+
 /**
  * @class SlottedPage - heap file implementation of DbBlock.
  *
  *      Manage a database block that contains several records.
         Modeled after slotted-page from Database Systems Concepts, 6ed, Figure 10-9.
 
-        Record id are handed out sequentially starting with 1 as records are added with add().
+        Record id are handed out sequentially starting with 1 as records are added with add(),
+        except that the id of a deleted record is handed out again before a new one is used.
         Each record has a header which is a fixed offset from the beginning of the block:
-            Bytes 0x00 - Ox01: number of records
+            Bytes 0x00 - Ox01: number of record headers
             Bytes 0x02 - 0x03: offset to end of free space
-            Bytes 0x04 - 0x05: size of record 1
-            Bytes 0x06 - 0x07: offset to record 1
+            Bytes 0x04 - 0x05: id of the most recently deleted record header (0 for none)
+            Bytes 0x06 - 0x07: reserved (0)
+            Bytes 0x08 - 0x09: size of record 1
+            Bytes 0x0A - 0x0B: offset to record 1
             etc.
+        A deleted record's header has an offset of 0 and, in place of its size, the id of the
+        next deleted record header, so the free slots form a list.
+
+        Deleting or shrinking a record leaves a hole in the record area instead of sliding the
+        other records over; the holes are squeezed out (compact) only when an add or an enlarging
+        put can't otherwise find contiguous room.
+
+        The block may be 4, 8, 16 or 32kB (whatever size the Dbt is); offsets are 16 bits,
+        so 32kB is the most we can address.
+
+        A page handed out by HeapFile sits in a BufferPool frame and keeps that frame pinned
+        for as long as the SlottedPage object (or any copy of it) is alive.
  *
  */
 class SlottedPage : public DbBlock {
 public:
-    SlottedPage(Dbt &block, BlockID block_id, bool is_new = false);
+    SlottedPage(Dbt &block, BlockID block_id, bool is_new = false, BufferFrame *frame = nullptr);
 
-    // Big 5 - use the defaults
-    virtual ~SlottedPage() {}
+    // Big 5 - copies share (and pin) the same buffer frame
+    virtual ~SlottedPage();
+
+    SlottedPage(const SlottedPage &other);
+
+    SlottedPage &operator=(const SlottedPage &other);
 
     virtual RecordID add(const Dbt *data);
 
     virtual Dbt *get(RecordID record_id) const;
 
+    virtual RecordView view(RecordID record_id) const;
+
     virtual void put(RecordID record_id, const Dbt &data);
 
     virtual void del(RecordID record_id);
 
     virtual RecordIDs *ids(void) const;
 
+    virtual RecordID next_id(RecordID record_id) const;
+
+    virtual u_int16_t free_space() const;
+
+    /**
+     * Get the buffer pool frame this page lives in.
+     * @returns  the frame, or nullptr if the page's memory is not from the pool
+     */
+    BufferFrame *get_frame() const { return frame; }
+
 protected:
     uint16_t num_records;
     uint16_t end_free;
+    uint16_t free_slot;  // head of the list of deleted record headers
+    BufferFrame *frame;
+    mutable int live_bytes;  // total size of the live records, or -1 if not counted yet
 
     void get_header(uint16_t &size, uint16_t &loc, RecordID id = 0) const;
 
@@ -53,7 +89,17 @@ protected:
 
     bool has_room(uint16_t size) const;
 
-    virtual void slide(uint16_t start, uint16_t end);
+    bool has_contiguous_room(uint16_t size) const;
+
+    uint16_t headers_end() const;
+
+    int hole_bytes() const;
+
+    uint16_t append(const Dbt *data);
+
+    void release(uint16_t size, uint16_t loc);
+
+    virtual void compact();
 
     uint16_t get_n(uint16_t offset) const;
 
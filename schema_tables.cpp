@@ -48,6 +48,7 @@ bool is_acceptable_data_type(std::string dt) {
  */
 const Identifier Tables::TABLE_NAME = "_tables";
 Columns *Tables::columns_table = nullptr;
+Indices *Tables::indices_table = nullptr;
 std::map<Identifier, DbRelation *> Tables::table_cache;
 
 // get the column name for _tables column
@@ -120,22 +121,20 @@ void Tables::get_columns(Identifier table_name, ColumnNames &column_names, Colum
     // SELECT * FROM _columns WHERE table_name = <table_name>
     ValueDict where;
     where["table_name"] = table_name;
-    Handles *handles = Tables::columns_table->select(&where);
+    Rows *rows = Tables::columns_table->scan(&where, nullptr);
 
     ColumnAttribute column_attribute;
-    for (auto const &handle: *handles) {
-        ValueDict *row = Tables::columns_table->project(
-                handle);  // get the row's values: {'column_name': <name>, 'data_type': <type>}
+    for (auto const &row: *rows) {  // each row's values: {'column_name': <name>, 'data_type': <type>}
 
-        Identifier column_name = (*row)["column_name"].s;
+        Identifier column_name = row->at("column_name").s;
         column_names.push_back(column_name);
 
         ColumnAttribute::DataType data_type;
-        if ((*row)["data_type"].s == "INT")
+        if (row->at("data_type").s == "INT")
             data_type = ColumnAttribute::INT;
-        else if ((*row)["data_type"].s == "TEXT")
+        else if (row->at("data_type").s == "TEXT")
             data_type = ColumnAttribute::TEXT;
-        else if ((*row)["data_type"].s == "BOOLEAN")
+        else if (row->at("data_type").s == "BOOLEAN")
             data_type = ColumnAttribute::BOOLEAN;
         else
             throw DbRelationError("Unknown data type");
@@ -145,7 +144,7 @@ void Tables::get_columns(Identifier table_name, ColumnNames &column_names, Colum
 
         delete row;
     }
-    delete handles;
+    delete rows;
 }
 
 // Return a table for given table_name.
@@ -160,9 +159,20 @@ DbRelation &Tables::get_table(Identifier table_name) {
     get_columns(table_name, column_names, column_attributes);
     DbRelation *table = new HeapTable(table_name, column_names, column_attributes);
     Tables::table_cache[table_name] = table;
+
+    // get its indices, so they are kept up to date with any changes to it
+    if (Tables::indices_table != nullptr)
+        for (auto const &index_name: Tables::indices_table->get_index_names(table_name))
+            Tables::indices_table->get_index(table_name, index_name);
     return *table;
 }
 
+// Write back what every table we've constructed is holding in memory.
+void Tables::flush_all() {
+    for (auto const &entry: Tables::table_cache)
+        entry.second->flush();
+}
+
 
 /*
  * ****************************
@@ -296,8 +306,15 @@ ColumnAttributes &Indices::COLUMN_ATTRIBUTES() {
     return cas;
 }
 
-// ctor - we have a fixed table structure
+// ctor - we have a fixed table structure; the first one made is the one Tables uses
 Indices::Indices() : HeapTable(TABLE_NAME, COLUMN_NAMES(), COLUMN_ATTRIBUTES()) {
+    if (Tables::indices_table == nullptr)
+        Tables::indices_table = this;
+}
+
+Indices::~Indices() {
+    if (Tables::indices_table == this)
+        Tables::indices_table = nullptr;
 }
 
 // Manually check constraints -- unique on (table, index, column)
@@ -333,6 +350,7 @@ void Indices::del(Handle handle) {
     if (Indices::index_cache.find(cache_key) != Indices::index_cache.end()) {
         DbIndex *index = Indices::index_cache.at(cache_key);
         Indices::index_cache.erase(cache_key);
+        Tables::get_table(table_name).remove_index(index);
         delete index;
     }
     HeapTable::del(handle);
@@ -345,48 +363,26 @@ void Indices::get_columns(Identifier table_name, Identifier index_name, ColumnNa
     ValueDict where;
     where["table_name"] = table_name;
     where["index_name"] = index_name;
-    Handles *handles = select(&where);
+    Rows *rows = scan(&where, nullptr);
 
     Identifier colnames[DbIndex::MAX_COMPOSITE];
     uint size = 0;
-    for (auto const &handle: *handles) {
-        ValueDict *row = project(handle);
+    for (auto const &row: *rows) {
 
-        Identifier column_name = (*row)["column_name"].s;
-        uint which = (uint) (*row)["seq_in_index"].n;
+        Identifier column_name = row->at("column_name").s;
+        uint which = (uint) row->at("seq_in_index").n;
         colnames[which - 1] = column_name;  // seq_in_index is 1-based
         if (which > size)
             size = which;
-        is_unique = (*row)["is_unique"].n != 0;
-        is_hash = (*row)["index_type"].s == "HASH";
+        is_unique = row->at("is_unique").n != 0;
+        is_hash = row->at("index_type").s == "HASH";
         delete row;
     }
     for (uint i = 0; i < size; i++)
         column_names.push_back(colnames[i]);
-    delete handles;
+    delete rows;
 }
 
-// FIXME - use this for now until we have BTreeIndex and HashIndex
-class DummyIndex : public DbIndex {
-public:
-    DummyIndex(DbRelation &rel, Identifier idx, ColumnNames key, bool unq) : DbIndex(rel, idx, key, unq) {}
-
-    void create() {}
-
-    void drop() {}
-
-    void open() {}
-
-    void close() {}
-
-    Handles *lookup(ValueDict *key_values) const { return nullptr; }
-
-    void insert(Handle handle) {}
-
-    void del(Handle handle) {}
-};
-
-
 // Return a table for given table_name.
 DbIndex &Indices::get_index(Identifier table_name, Identifier index_name) {
     // if they are asking about an index we've once constructed, then just return that one
@@ -394,18 +390,23 @@ DbIndex &Indices::get_index(Identifier table_name, Identifier index_name) {
     if (Indices::index_cache.find(cache_key) != Indices::index_cache.end())
         return *Indices::index_cache[cache_key];
 
-    // otherwise assume it is a DummyIndex (for now)
+    // getting a table for the first time attaches all its indices, this one among them
+    DbRelation &table = Tables::get_table(table_name);
+    if (Indices::index_cache.find(cache_key) != Indices::index_cache.end())
+        return *Indices::index_cache[cache_key];
+
+    // otherwise construct it from its rows in _indices
     ColumnNames column_names;
     bool is_hash, is_unique;
     get_columns(table_name, index_name, column_names, is_hash, is_unique);
-    DbRelation &table = Tables::get_table(table_name);
     DbIndex *index;
     if (is_hash) {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to HashIndex
+        index = new HashIndex(table, index_name, column_names, is_unique);
     } else {
-        index = new DummyIndex(table, index_name, column_names, is_unique);  // FIXME - change to BTreeIndex
+        index = new BTreeIndex(table, index_name, column_names, is_unique);
     }
     Indices::index_cache[cache_key] = index;
+    table.add_index(index);
     return *index;
 }
 
@@ -414,12 +415,19 @@ IndexNames Indices::get_index_names(Identifier table_name) {
     ValueDict where;
     where["table_name"] = Value(table_name);
     where["seq_in_index"] = Value(1);  // only get the row for the first column if composite index
-    Handles *handles = select(&where);
-    for (auto const &handle: *handles) {
-        ValueDict *row = project(handle);
-        ret.push_back((*row)["index_name"].s);
+    ColumnNames column_names;
+    column_names.push_back("index_name");
+    Rows *rows = scan(&where, &column_names);
+    for (auto const &row: *rows) {
+        ret.push_back(row->at("index_name").s);
         delete row;
     }
-    delete handles;
+    delete rows;
     return ret;
-}
\ No newline at end of file
+}
+
+// Write back what every index we've constructed is holding in memory.
+void Indices::flush_all() {
+    for (auto const &entry: Indices::index_cache)
+        entry.second->flush();
+}
@@ -8,6 +8,8 @@
 #pragma once
 
 #include "heap_storage.h"
+#include "BTreeIndex.h"
+#include "HashIndex.h"
 
 /**
  * Initialize access to the schema tables.
@@ -18,6 +20,7 @@ void initialize_schema_tables();
 
 
 class Columns; // forward declare
+class Indices; // forward declare
 
 /**
  * @class Tables - The singleton table that stores the metadata for all other tables.
@@ -41,6 +44,9 @@ public:
 
     virtual Handle insert(const ValueDict *row);
 
+    // one row at a time so the uniqueness check in insert() applies
+    virtual Handles *insert_batch(const ValueDicts *rows) { return DbRelation::insert_batch(rows); }
+
     virtual void del(Handle handle);
 
     /**
@@ -54,12 +60,18 @@ public:
     static void get_columns(Identifier table_name, ColumnNames &column_names, ColumnAttributes &column_attributes);
 
     /**
-     * Get the correctly instantiated DbRelation for a given table.
+     * Get the correctly instantiated DbRelation for a given table, with its indices attached
+     * so they are kept up to date.
      * @param table_name  table to get
      * @returns           instantiated DbRelation of the correct type
      */
     static DbRelation &get_table(Identifier table_name);
 
+    /**
+     * Flush all the tables gotten so far (and _tables and _columns).
+     */
+    static void flush_all();
+
 protected:
     // hard-coded columns for _tables table
     static ColumnNames &COLUMN_NAMES();
@@ -69,6 +81,13 @@ protected:
     // keep a reference to the columns table (for get_columns method)
     static Columns *columns_table;
 
+    // and to the indices table (for get_table to attach a table's indices); set by Indices
+    static Indices *indices_table;
+
+    friend class Indices;
+
+    friend bool test_sql_exec();
+
 private:
     // keep a cache of all the tables we've instantiated so far
     static std::map<Identifier, DbRelation *> table_cache;
@@ -95,6 +114,9 @@ public:
 
     virtual Handle insert(const ValueDict *row);
 
+    // one row at a time so the checks in insert() apply
+    virtual Handles *insert_batch(const ValueDicts *rows) { return DbRelation::insert_batch(rows); }
+
 protected:
     // hard-coded columns for the _columns table
     static ColumnNames &COLUMN_NAMES();
@@ -114,7 +136,7 @@ public:
     // ctor/dtor
     Indices();
 
-    virtual ~Indices() {}
+    virtual ~Indices();
 
     /**
      * Get the search key for the given index.
@@ -130,7 +152,8 @@ public:
                              bool &is_unique);
 
     /**
-     * Get the instantiated DbIndex for the given index.
+     * Get the instantiated DbIndex for the given index. A newly instantiated one is attached
+     * to its table (see DbRelation::add_index).
      * @param table_name  what table the requested index is on
      * @param index_name  name of index (unique by table)
      * @returns           DbIndex for requested index
@@ -144,9 +167,17 @@ public:
      */
     virtual IndexNames get_index_names(Identifier table_name);
 
+    /**
+     * Flush all the indices gotten so far.
+     */
+    static void flush_all();
+
     // overrides
     virtual Handle insert(const ValueDict *row);
 
+    // one row at a time so the uniqueness check in insert() applies
+    virtual Handles *insert_batch(const ValueDicts *rows) { return DbRelation::insert_batch(rows); }
+
     virtual void del(Handle handle);
 
 protected:
@@ -154,6 +185,8 @@ protected:
 
     static ColumnAttributes &COLUMN_ATTRIBUTES();
 
+    friend bool test_sql_exec();
+
 private:
     static std::map<std::pair<Identifier, Identifier>, DbIndex *> index_cache;
 };
@@ -40,10 +40,19 @@ int main(int argc, char *argv[]) {
         getline(cin, query);
         if (query.length() == 0)
             continue;  // blank line -- just skip
-        if (query == "quit")
+        if (query == "quit") {
+            BufferPool::get_pool().flush_all();  // write back anything still dirty in the buffer pool
             break;  // only way to get out
+        }
         if (query == "test") {
             cout << "test_heap_storage: " << (test_heap_storage() ? "ok" : "failed") << endl;
+            cout << "test_btree: " << (test_btree() ? "ok" : "failed") << endl;
+            cout << "test_hash_index: " << (test_hash_index() ? "ok" : "failed") << endl;
+            cout << "test_sql_exec: " << (test_sql_exec() ? "ok" : "failed") << endl;
+            continue;
+        }
+        if (query == "benchmark") {
+            cout << "benchmark_heap_engines: " << (benchmark_heap_engines() ? "ok" : "failed") << endl;
             continue;
         }
 
@@ -79,7 +88,7 @@ void initialize_environment(char *envHome) {
     env->set_message_stream(&cout);
     env->set_error_stream(&cerr);
     try {
-        env->open(envHome, DB_CREATE | DB_INIT_MPOOL, 0);
+        env->open(envHome, DB_CREATE | DB_INIT_MPOOL | DB_THREAD, 0);  // tables can be scanned by several threads
     } catch (DbException &exc) {
         cerr << "(sql5300: " << exc.what() << ")" << endl;
         exit(1);
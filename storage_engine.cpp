@@ -17,6 +17,48 @@ bool Value::operator!=(const Value &other) const {
     return !(*this == other);
 }
 
+Value ValueView::to_value() const {
+    Value value;
+    value.data_type = this->data_type;
+    if (this->data_type == ColumnAttribute::TEXT)
+        value.s.assign(this->s, this->s_size);
+    else
+        value.n = this->n;
+    return value;
+}
+
+bool ValueView::operator==(const Value &other) const {
+    if (this->data_type != other.data_type)
+        return false;
+    if (this->data_type != ColumnAttribute::TEXT)
+        return this->n == other.n;
+    return this->s_size == other.s.size() && other.s.compare(0, this->s_size, this->s, this->s_size) == 0;
+}
+
+// Find the position of a column in the row (there are only ever a handful, so just look).
+uint Row::ordinal(const Identifier &column_name) const {
+    for (uint i = 0; i < this->column_names->size(); i++)
+        if ((*this->column_names)[i] == column_name)
+            return i;
+    throw DbRelationError("row does not have column named '" + column_name + "'");
+}
+
+Value &Row::at(const Identifier &column_name) {
+    return this->values[ordinal(column_name)];
+}
+
+const Value &Row::at(const Identifier &column_name) const {
+    return this->values[ordinal(column_name)];
+}
+
+// Compatibility adapter for callers that still want a dictionary.
+ValueDict *Row::to_dict() const {
+    ValueDict *dict = new ValueDict();
+    for (uint i = 0; i < this->values.size(); i++)
+        (*dict)[(*this->column_names)[i]] = this->values[i];
+    return dict;
+}
+
 // Just pulls out the column names from a ValueDict and passes that to the usual form of project().
 ValueDict *DbRelation::project(Handle handle, const ValueDict *where) {
     ColumnNames t;
@@ -25,3 +67,55 @@ ValueDict *DbRelation::project(Handle handle, const ValueDict *where) {
     return this->project(handle, &t);
 }
 
+
+// Generic form: one insert() per row, undone with del() if a row fails.
+Handles *DbRelation::insert_batch(const ValueDicts *rows) {
+    Handles *handles = new Handles();
+    try {
+        for (auto const &row: *rows)
+            handles->push_back(this->insert(row));
+    } catch (...) {
+        for (auto const &handle: *handles)
+            this->del(handle);
+        delete handles;
+        throw;
+    }
+    return handles;
+}
+
+// Generic form: a cursor over the qualifying rows, projecting each one as it goes.
+Rows *DbRelation::scan(const ValueDict *where, const ColumnNames *column_names) {
+    Rows *rows = new Rows();
+    DbCursor *qualifying = nullptr;
+    try {
+        qualifying = this->cursor(where, column_names);
+        Handle handle;
+        Row *row;
+        while (qualifying->next(handle, row))
+            rows->push_back(row);
+    } catch (...) {
+        delete qualifying;
+        for (auto const &row: *rows)
+            delete row;
+        delete rows;
+        throw;
+    }
+    delete qualifying;
+    return rows;
+}
+
+// Data types of the key columns, from the relation's column attributes.
+KeyProfile DbIndex::get_key_profile() const {
+    KeyProfile profile;
+    const ColumnNames &column_names = this->relation.get_column_names();
+    ColumnAttributes column_attributes = this->relation.get_column_attributes();
+    for (auto const &key_column: this->key_columns) {
+        uint i = 0;
+        while (i < column_names.size() && column_names[i] != key_column)
+            i++;
+        if (i == column_names.size())
+            throw DbRelationError("unknown column " + key_column + " in index " + this->name);
+        profile.push_back(column_attributes[i].get_data_type());
+    }
+    return profile;
+}
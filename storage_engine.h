@@ -10,6 +10,7 @@
 #pragma once
 
 #include <exception>
+#include <iterator>
 #include <map>
 #include <utility>
 #include <vector>
@@ -28,6 +29,58 @@ typedef u_int32_t BlockID;
 typedef std::vector<RecordID> RecordIDs;
 typedef std::length_error DbBlockNoRoomError;
 
+class DbBlock;  // forward declare
+class DbFile;
+
+/**
+ * @class RecordIterator - forward iterator over the live record ids of a DbBlock
+ * Ids are produced lazily with DbBlock::next_id, so nothing is allocated.
+ */
+class RecordIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef RecordID value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const RecordID *pointer;
+    typedef const RecordID &reference;
+
+    RecordIterator(const DbBlock *block, RecordID record_id) : block(block), record_id(record_id) {}
+
+    reference operator*() const { return record_id; }
+
+    RecordIterator &operator++();
+
+    RecordIterator operator++(int) {
+        RecordIterator before = *this;
+        ++*this;
+        return before;
+    }
+
+    bool operator==(const RecordIterator &other) const { return record_id == other.record_id; }
+
+    bool operator!=(const RecordIterator &other) const { return record_id != other.record_id; }
+
+protected:
+    const DbBlock *block;
+    RecordID record_id;  // 0 is the end
+};
+
+/**
+ * @class RecordView - a record's bytes where they sit in its block, without a copy
+ *
+ * Only valid for as long as the block it came from (and so its buffer frame) is alive.
+ * A deleted record has a null data pointer.
+ */
+class RecordView {
+public:
+    const char *data;
+    uint size;
+
+    RecordView() : data(nullptr), size(0) {}
+
+    RecordView(const char *data, uint size) : data(data), size(size) {}
+};
+
 /**
  * @class DbBlock - abstract base class for blocks in our database files 
  * (DbBlock's belong to DbFile's.)
@@ -35,9 +88,12 @@ typedef std::length_error DbBlockNoRoomError;
  * Methods for putting/getting records in blocks:
  * 	add(data)
  * 	get(record_id)
+ * 	view(record_id)
  * 	put(record_id, data)
  * 	del(record_id)
  * 	ids()
+ * 	next_id(record_id)
+ * 	begin(), end()
  * Accessors:
  * 	get_block()
  * 	get_data()
@@ -46,10 +102,24 @@ typedef std::length_error DbBlockNoRoomError;
 class DbBlock {
 public:
     /**
-     * our blocks are 4kB
+     * our blocks are 4kB unless a file asks for bigger ones
      */
     static const uint BLOCK_SZ = 4096;
 
+    /**
+     * largest block a file may use (offsets within a block have to fit in 16 bits)
+     */
+    static const uint MAX_BLOCK_SZ = 32768;
+
+    /**
+     * Check for a block size we support: 4, 8, 16 or 32kB.
+     * @param block_size  size in bytes
+     * @returns           true if files may use it
+     */
+    static bool valid_block_size(uint block_size) {
+        return block_size >= BLOCK_SZ && block_size <= MAX_BLOCK_SZ && (block_size & (block_size - 1)) == 0;
+    }
+
     /**
      * ctor/dtor (subclasses should handle the big-5)
      */
@@ -72,6 +142,13 @@ public:
      */
     virtual Dbt *get(RecordID record_id) const = 0;
 
+    /**
+     * Look at a record in this block without copying or allocating anything.
+     * @param record_id  which record to look at
+     * @returns          view of the record's bytes in the block (data is nullptr if deleted)
+     */
+    virtual RecordView view(RecordID record_id) const = 0;
+
     /**
      * Change the data stored for a record in this block.
      * @param record_id  which record to update
@@ -93,6 +170,24 @@ public:
      */
     virtual RecordIDs *ids() const = 0;
 
+    /**
+     * Step to the next record id in this block (excluding deleted ones).
+     * @param record_id  the previous record id, or 0 to get the first one
+     * @returns          the following record id, or 0 if there are no more
+     */
+    virtual RecordID next_id(RecordID record_id) const = 0;
+
+    /**
+     * Iterate over the record ids in this block (excluding deleted ones) without building a list.
+     * @returns  iterator positioned at the first record id
+     */
+    RecordIterator begin() const { return RecordIterator(this, next_id(0)); }
+
+    /**
+     * @returns  iterator positioned past the last record id
+     */
+    RecordIterator end() const { return RecordIterator(this, 0); }
+
     /**
      * Access the whole block's memory as a BerkeleyDB Dbt pointer.
      * @returns  Dbt used by this block
@@ -105,6 +200,12 @@ public:
      */
     virtual void *get_data() { return block.get_data(); }
 
+    /**
+     * Get the size of this block (set by the file it belongs to).
+     * @returns  size in bytes
+     */
+    virtual uint get_block_size() const { return block.get_size(); }
+
     /**
      * Get this block's BlockID within its DbFile.
      * @returns this block's id
@@ -116,8 +217,46 @@ protected:
     BlockID block_id;
 };
 
+inline RecordIterator &RecordIterator::operator++() {
+    record_id = block->next_id(record_id);
+    return *this;
+}
+
 // convenience type alias
-typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<BlockID> BlockIDs;  // prefer iterating the DbFile itself (see BlockIterator)
+
+/**
+ * @class BlockIterator - forward iterator over the block ids of a DbFile
+ * Ids are produced lazily with DbFile::next_block_id, so nothing is allocated.
+ */
+class BlockIterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef BlockID value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const BlockID *pointer;
+    typedef const BlockID &reference;
+
+    BlockIterator(const DbFile *file, BlockID block_id) : file(file), block_id(block_id) {}
+
+    reference operator*() const { return block_id; }
+
+    BlockIterator &operator++();
+
+    BlockIterator operator++(int) {
+        BlockIterator before = *this;
+        ++*this;
+        return before;
+    }
+
+    bool operator==(const BlockIterator &other) const { return block_id == other.block_id; }
+
+    bool operator!=(const BlockIterator &other) const { return block_id != other.block_id; }
+
+protected:
+    const DbFile *file;
+    BlockID block_id;  // 0 is the end
+};
 
 /**
  * @class DbFile - abstract base class which represents a disk-based collection of DbBlocks
@@ -129,6 +268,8 @@ typedef std::vector<BlockID> BlockIDs;  // FIXME: will need to turn this into an
  *	get(block_id)
  *	put(block)
  *	block_ids()
+ *	next_block_id(block_id)
+ *	begin(), end()
  */
 class DbFile {
 public:
@@ -178,15 +319,38 @@ public:
 
     /**
      * Get a list of all the valid BlockID's in the file
-     * FIXME - not a good long-term approach, but we'll do this until we put in iterators
+     * Scans should iterate the file instead (see begin/end) rather than materializing this list.
      * @returns  a pointer to vector of BlockIDs (freed by caller)
      */
     virtual BlockIDs *block_ids() const = 0;
 
+    /**
+     * Step to the next valid BlockID in the file.
+     * @param block_id  the previous block id, or 0 to get the first one
+     * @returns         the following block id, or 0 if there are no more
+     */
+    virtual BlockID next_block_id(BlockID block_id) const = 0;
+
+    /**
+     * Iterate over the valid block ids in the file without building a list.
+     * @returns  iterator positioned at the first block id
+     */
+    BlockIterator begin() const { return BlockIterator(this, next_block_id(0)); }
+
+    /**
+     * @returns  iterator positioned past the last block id
+     */
+    BlockIterator end() const { return BlockIterator(this, 0); }
+
 protected:
     std::string name;  // filename (or part of it)
 };
 
+inline BlockIterator &BlockIterator::operator++() {
+    block_id = file->next_block_id(block_id);
+    return *this;
+}
+
 
 /**
  * @class ColumnAttribute - holds datatype and other info for a column
@@ -232,14 +396,49 @@ public:
     bool operator!=(const Value &other) const;
 };
 
+/**
+ * @class ValueView - a field value that refers to a record's bytes instead of owning a copy
+ *
+ * TEXT values point into the block the record came from (they are not nul-terminated), so a
+ * view is only valid as long as that block is.
+ */
+class ValueView {
+public:
+    ColumnAttribute::DataType data_type;
+    int32_t n;
+    const char *s;
+    uint s_size;
+
+    ValueView() : data_type(ColumnAttribute::INT), n(0), s(nullptr), s_size(0) {}
+
+    /**
+     * @returns  a copy of the TEXT bytes
+     */
+    std::string str() const { return std::string(s, s_size); }
+
+    /**
+     * @returns  an owning copy of this value
+     */
+    Value to_value() const;
+
+    bool operator==(const Value &other) const;
+
+    bool operator!=(const Value &other) const { return !(*this == other); }
+};
+
+typedef std::vector<ValueView> ValueViews;
+
 // More type aliases
 typedef std::string Identifier;
 typedef std::vector<Identifier> ColumnNames;
 typedef std::vector<ColumnAttribute> ColumnAttributes;
+typedef std::vector<uint> ColumnOrdinals;
 typedef std::pair<BlockID, RecordID> Handle;
-typedef std::vector<Handle> Handles;  // FIXME: will need to turn this into an iterator at some point
+typedef std::vector<Handle> Handles;  // use a DbCursor to stream handles instead of collecting them
 typedef std::map<Identifier, Value> ValueDict;
 typedef std::vector<ValueDict *> ValueDicts;
+typedef std::vector<Value> KeyValue;  // values of an index's key columns, in index order
+typedef std::vector<ColumnAttribute::DataType> KeyProfile;  // data types of an index's key columns
 
 
 /**
@@ -251,6 +450,97 @@ public:
 };
 
 
+/**
+ * @class Row - the values of one row, indexed by column ordinal
+ *
+ * Unlike a ValueDict, a row doesn't copy its column names: it points at a list of them owned
+ * by whoever produced the row (the relation, or the caller that asked for a projection), so
+ * that list must outlive the row. Use to_dict() where a ValueDict is still expected.
+ */
+class Row {
+public:
+    Row(const ColumnNames *column_names) : column_names(column_names), values(column_names->size()) {}
+
+    virtual ~Row() {}
+
+    /**
+     * Accessor for the value in a given column position.
+     * @param ordinal  0-based position in get_column_names()
+     * @returns        the value
+     */
+    Value &operator[](uint ordinal) { return values[ordinal]; }
+
+    const Value &operator[](uint ordinal) const { return values[ordinal]; }
+
+    /**
+     * Accessor for the value in a named column (a linear search of the column names).
+     * @param column_name  which column
+     * @returns            the value
+     * @throws             DbRelationError if the row has no such column
+     */
+    Value &at(const Identifier &column_name);
+
+    const Value &at(const Identifier &column_name) const;
+
+    /**
+     * @returns  the column names for this row's values, in order
+     */
+    const ColumnNames *get_column_names() const { return column_names; }
+
+    /**
+     * @returns  number of values in the row
+     */
+    uint size() const { return (uint) values.size(); }
+
+    /**
+     * Copy the row into a dictionary keyed by column name.
+     * @returns  the dictionary (freed by caller)
+     */
+    ValueDict *to_dict() const;
+
+protected:
+    const ColumnNames *column_names;
+    std::vector<Value> values;
+
+    uint ordinal(const Identifier &column_name) const;
+};
+
+typedef std::vector<Row *> Rows;
+
+
+/**
+ * @class DbCursor - steps lazily through the rows of a DbRelation that satisfy a where clause
+ */
+class DbCursor {
+public:
+    virtual ~DbCursor() {}
+
+    /**
+     * Advance to the next qualifying row.
+     * @param handle  returned by reference: handle of the row
+     * @returns       false if there are no more rows (handle is not set)
+     */
+    virtual bool next(Handle &handle) = 0;
+
+    /**
+     * Advance to the next qualifying row and project it in the same pass.
+     * @param handle  returned by reference: handle of the row
+     * @param row     returned by reference: the cursor's projection of the row (freed by caller)
+     * @returns       false if there are no more rows (handle and row are not set)
+     */
+    virtual bool next(Handle &handle, Row *&row) = 0;
+
+    /**
+     * Advance to the next qualifying row and decode its projection without copying it.
+     * @param handle  returned by reference: handle of the row
+     * @param row     filled in with views of the projected values (reused from call to call); they
+     *                are only valid until the next call on this cursor or its deletion
+     * @returns       false if there are no more rows (handle and row are not set)
+     */
+    virtual bool next(Handle &handle, ValueViews &row) = 0;
+};
+
+
 /**
  * @class DbRelation - top-level object handling a physical database relation
  * 
@@ -261,15 +551,24 @@ public:
  * 	
  * 	open()
  * 	close()
+ * 	flush()
  * 	
  *	insert(row)
+ *	insert_batch(rows)
  *	update(handle, new_values)
  *	del(handle)
  *	select()
  *	select(where)
+ *	cursor(where, column_names)
+ *	scan(where, column_names)
  *	project(handle)
  *	project(handle, column_names)
+ *
+ *	add_index(index)
+ *	remove_index(index)
  */
+class DbIndex;  // forward declare
+
 class DbRelation {
 public:
     // ctor/dtor
@@ -307,6 +606,11 @@ public:
      */
     virtual void close() = 0;
 
+    /**
+     * Write back any changes the relation is holding in memory, e.g., at the end of a statement.
+     */
+    virtual void flush() {}
+
     /**
      * Execute: INSERT INTO <table_name> ( <row_keys> ) VALUES ( <row_values> )
      * @param row  a dictionary keyed by column names
@@ -314,6 +618,15 @@ public:
      */
     virtual Handle insert(const ValueDict *row) = 0;
 
+    /**
+     * Execute: INSERT INTO <table_name> ( <row_keys> ) VALUES ( <row_values> ), ( <row_values> ), ...
+     * If a row fails, the rows before it are taken back out, so either all the rows are
+     * inserted or none are.
+     * @param rows  dictionaries keyed by column names
+     * @returns     handles to the new rows, in the same order (freed by caller)
+     */
+    virtual Handles *insert_batch(const ValueDicts *rows);
+
     /**
      * Conceptually, execute: UPDATE INTO <table_name> SET <new_values> WHERE <handle>
      * where handle is sufficient to identify one specific record (e.g., returned
@@ -344,6 +657,26 @@ public:
      */
     virtual Handles *select(const ValueDict *where) = 0;
 
+    /**
+     * Conceptually, execute: SELECT <handle> FROM <table_name> WHERE <where>
+     * but hand back the qualifying rows one at a time as the relation is scanned.
+     * @param where         where-clause predicates (nullptr for all rows)
+     * @param column_names  columns the cursor projects in next(handle, row) (nullptr or empty for all);
+     *                      the projected rows refer to this list, so it must outlive them
+     * @returns             a cursor positioned before the first qualifying row (freed by caller)
+     */
+    virtual DbCursor *cursor(const ValueDict *where = nullptr, const ColumnNames *column_names = nullptr) = 0;
+
+    /**
+     * Execute: SELECT <column_names> FROM <table_name> WHERE <where>
+     * in a single pass over the relation.
+     * @param where         where-clause predicates (nullptr for all rows)
+     * @param column_names  list of column names to project (nullptr or empty for all);
+     *                      the rows refer to this list, so it must outlive them
+     * @returns             list of projected rows (caller frees the list and the rows)
+     */
+    virtual Rows *scan(const ValueDict *where, const ColumnNames *column_names);
+
     /**
      * Return a sequence of all values for handle (SELECT *).
      * @param handle  row to get values from
@@ -369,6 +702,28 @@ public:
      */
     virtual ValueDict *project(Handle handle, const ValueDict *column_names);
 
+    /**
+     * Have the relation keep an index up to date as rows are inserted and deleted.
+     * @param index  an index on this relation (not owned by it)
+     */
+    virtual void add_index(DbIndex *index) {
+        throw DbRelationError("index maintenance not supported");
+    }
+
+    /**
+     * Stop keeping an index up to date.
+     * @param index  an index given to add_index
+     */
+    virtual void remove_index(DbIndex *index) {}
+
+    /**
+     * Accessor for table_name.
+     * @returns table_name   name of this relation
+     */
+    virtual Identifier get_table_name() const {
+        return table_name;
+    }
+
     /**
      * Accessor for column_names.
      * @returns column_names   list of column names for this relation, in order
@@ -458,11 +813,33 @@ public:
      */
     virtual void del(Handle record) = 0;
 
+    /**
+     * Insert the index entries for several records at once.
+     * @param records  handles (into relation) to the records to insert
+     *                 (must be in the relation at time of insertion)
+     */
+    virtual void insert_batch(const Handles *records) {
+        for (auto const &record: *records)
+            insert(record);
+    }
+
+    /**
+     * Write back any changes the index is holding in memory, e.g., at the end of a statement.
+     */
+    virtual void flush() {}
+
 protected:
     DbRelation &relation;
     Identifier name;
     ColumnNames key_columns;
     bool unique;
+
+    /**
+     * Look up the data types of the key columns in the relation.
+     * @returns  data type of each key column, in order
+     * @throws   DbRelationError if a key column isn't in the relation
+     */
+    virtual KeyProfile get_key_profile() const;
 };
 
 